@@ -0,0 +1,284 @@
+#ifndef RTLSDRPP_AUTOGAIN_HPP
+#define RTLSDRPP_AUTOGAIN_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <array>
+#include <vector>
+#include <span>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "rtlsdrpp.hpp"
+#include "sweep.hpp"
+
+namespace rtlsdr {
+
+// Bytes measured per gain probe (~3.4 ms of I/Q at 2.4 MS/s)
+const std::size_t DEFAULT_AGC_BURST = 16384;
+
+// Largest fraction of samples allowed to hit the ADC rails
+const double DEFAULT_MAX_CLIP = 1e-4;
+
+// Width of the frequency bands a ranged gain is reused across
+const std::uint32_t DEFAULT_GAIN_BAND = 10e6;
+
+struct LevelHistogram {
+	// How much of the ADC's range a block of raw bytes uses
+	//
+	// Each byte's magnitude |raw - 127.5| is rounded down to 0..127 and
+	// binned by how many bits it needs, so bits[7] is the top octave and
+	// bits[0] is silence. `clipped` counts bytes sitting on a rail (0 or
+	// 255), which are also in bits[7].
+	std::array<std::uint64_t, 8> bits{};
+	std::uint64_t clipped = 0;
+	std::uint64_t total = 0;
+
+	double clip_fraction() const { return total ? static_cast<double>(clipped) / total : 0; }
+
+	int peak_bits() const {
+		// Bits needed by the loudest octave that's occupied
+		for (int k = 7; k > 0; k--) {
+			if (bits[k]) {
+				return k;
+			}
+		}
+		return 0;
+	}
+};
+
+namespace detail {
+
+inline std::size_t level_counts_simd(const unsigned char* in, std::size_t n, std::uint64_t* ge) {
+	// Counts bytes whose magnitude exceeds 0, 1, 3, 7, 15, 31, 63 and 126
+	// (ge[0..7]). Returns how many bytes it handled; the caller does the
+	// tail. Magnitude is (raw ^ 0x80) folded onto 0..127 by xor with its
+	// sign, so 0 and 255 both land on 127.
+	std::size_t i = 0;
+
+#if defined(__AVX2__)
+	const __m256i bias = _mm256_set1_epi8(static_cast<char>(0x80));
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i thr[8] = {
+		_mm256_set1_epi8(0),  _mm256_set1_epi8(1),  _mm256_set1_epi8(3),  _mm256_set1_epi8(7),
+		_mm256_set1_epi8(15), _mm256_set1_epi8(31), _mm256_set1_epi8(63), _mm256_set1_epi8(126)
+	};
+
+	while (i + 32 <= n) {
+		// 8 bit lane counters, flushed before they can wrap
+		__m256i acc[8];
+		for (auto& a: acc) {
+			a = zero;
+		}
+
+		std::size_t stop = std::min(n - (n - i) % 32, i + 255*32);
+		for (; i < stop; i += 32) {
+			__m256i s = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)), bias);
+			__m256i m = _mm256_xor_si256(s, _mm256_cmpgt_epi8(zero, s));
+
+			for (int k = 0; k < 8; k++) {
+				acc[k] = _mm256_sub_epi8(acc[k], _mm256_cmpgt_epi8(m, thr[k]));
+			}
+		}
+
+		for (int k = 0; k < 8; k++) {
+			__m256i sums = _mm256_sad_epu8(acc[k], zero);
+			ge[k] += _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+				_mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+		}
+	}
+#elif defined(__ARM_NEON)
+	const uint8x16_t bias = vdupq_n_u8(0x80);
+	const std::uint8_t thr_vals[8] = {0, 1, 3, 7, 15, 31, 63, 126};
+
+	while (i + 16 <= n) {
+		uint8x16_t acc[8];
+		for (auto& a: acc) {
+			a = vdupq_n_u8(0);
+		}
+
+		std::size_t stop = std::min(n - (n - i) % 16, i + 255*16);
+		for (; i < stop; i += 16) {
+			int8x16_t s = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(in + i), bias));
+			uint8x16_t m = vreinterpretq_u8_s8(veorq_s8(s, vshrq_n_s8(s, 7)));
+
+			for (int k = 0; k < 8; k++) {
+				acc[k] = vsubq_u8(acc[k], vcgtq_u8(m, vdupq_n_u8(thr_vals[k])));
+			}
+		}
+
+		for (int k = 0; k < 8; k++) {
+			uint64x2_t sums = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(acc[k])));
+			ge[k] += vgetq_lane_u64(sums, 0) + vgetq_lane_u64(sums, 1);
+		}
+	}
+#else
+	(void)in;
+	(void)n;
+	(void)ge;
+#endif
+
+	return i;
+}
+
+} // namespace detail
+
+inline LevelHistogram level_histogram(std::span<const unsigned char> bytes) {
+	// Bins raw dongle bytes (I/Q or direct sampling) by magnitude
+	std::uint64_t ge[8] = {};
+	std::size_t i = detail::level_counts_simd(bytes.data(), bytes.size(), ge);
+
+	for (; i < bytes.size(); i++) {
+		unsigned m = (bytes[i] >= 128) ? bytes[i] - 128 : 127 - bytes[i];
+		for (int k = 0; k < 7; k++) {
+			ge[k] += (m > (1u << k) - 1);
+		}
+		ge[7] += (m > 126);
+	}
+
+	LevelHistogram h;
+	h.total = bytes.size();
+	h.clipped = ge[7];
+	h.bits[0] = h.total - ge[0];
+	for (int k = 1; k < 7; k++) {
+		h.bits[k] = ge[k-1] - ge[k];
+	}
+	h.bits[7] = ge[6];
+
+	return h;
+}
+
+class AutoGain {
+	// Picks the highest manual gain that doesn't clip
+	//
+	// More gain lifts weak emanations out of the 8 bit quantization floor
+	// until strong signals start hitting the ADC rails. Clipping fraction
+	// only grows with gain, so the best setting is found by binary search
+	// over the backend's `gain_steps()`: a handful of short bursts instead
+	// of a pass over every gain.
+	//
+	// Results are cached per `band_hz` wide frequency band, so a sweep only
+	// pays for ranging the first time it enters each band.
+	//
+	// Arguments:
+	//	sdr: Backend to range; its gain is left at the chosen setting
+	//	burst_bytes: Bytes measured per probe
+	//	max_clip: Largest acceptable fraction of railed samples
+	//	band_hz: Width of the bands results are cached for
+	//	settle_bytes: Bytes discarded after each gain change
+	//
+	// Notes:
+	//	In direct sampling mode the tuner (and so its gain) is bypassed;
+	//	ranging there only wastes reads.
+	//
+public:
+	AutoGain(SdrBackend& sdr_, std::size_t burst_bytes_=DEFAULT_AGC_BURST, double max_clip_=DEFAULT_MAX_CLIP,
+		std::uint32_t band_hz_=DEFAULT_GAIN_BAND, std::size_t settle_bytes_=DEFAULT_SETTLE_BYTES):
+
+		sdr(sdr_), steps(sdr.gain_steps()), burst_bytes(burst_bytes_), max_clip(max_clip_),
+		band_hz(band_hz_), settle_bytes(settle_bytes_) {
+
+		if (steps.empty()) {
+			throw std::logic_error("AutoGain needs a backend with manual gain steps");
+		}
+		if (band_hz == 0) {
+			throw std::invalid_argument("AutoGain band width must be nonzero");
+		}
+	}
+
+	int range(std::uint32_t freq) {
+		// Tunes to `freq` and sets the best gain for its band
+		sdr.set_center_freq(freq);
+		return range();
+	}
+
+	int range() {
+		// Sets the best gain for the band the backend is tuned to
+		//
+		// Returns:
+		//	int: Chosen gain, dB
+		//
+		std::uint32_t band = sdr.get_center_freq() / band_hz;
+
+		auto it = cache.find(band);
+		if (it != std::end(cache)) {
+			sdr.set_gain(it->second);
+			return it->second;
+		}
+
+		// Invariant: steps[lo] doesn't clip (or lo = -1), steps[hi] does
+		// (or hi = size)
+		int lo = -1, hi = steps.size();
+		while (hi - lo > 1) {
+			int mid = (lo + hi) / 2;
+			if (probe(steps[mid]).clip_fraction() <= max_clip) {
+				lo = mid;
+			}
+			else {
+				hi = mid;
+			}
+		}
+
+		int gain = steps[std::max(lo, 0)];
+		sdr.set_gain(gain);
+		cache[band] = gain;
+
+		return gain;
+	}
+
+	void forget() { cache.clear(); }
+	std::size_t cached_bands() const { return cache.size(); }
+	std::size_t probes() const { return num_probes; }
+
+	const LevelHistogram& last_histogram() const { return hist; }
+
+private:
+	const LevelHistogram& probe(int gain) {
+		sdr.set_gain(gain);
+		if (settle_bytes > 0) {
+			sdr.read_bytes_view(settle_bytes);
+		}
+
+		hist = level_histogram(sdr.read_bytes_view(burst_bytes));
+		num_probes++;
+
+		return hist;
+	}
+
+	SdrBackend& sdr;
+	std::vector<int> steps;
+	std::size_t burst_bytes;
+	double max_clip;
+	std::uint32_t band_hz;
+	std::size_t settle_bytes;
+
+	std::unordered_map<std::uint32_t, int> cache; // band index -> gain, dB
+	LevelHistogram hist;
+	std::size_t num_probes = 0;
+};
+
+} // namespace rtlsdr
+
+#endif
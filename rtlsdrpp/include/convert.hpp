@@ -0,0 +1,172 @@
+#ifndef RTLSDRPP_CONVERT_HPP
+#define RTLSDRPP_CONVERT_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <array>
+#include <span>
+#include <complex>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace rtlsdr {
+
+// The dongle's ADC is unsigned 8 bit, centered on 127.5. Every converter
+// maps 0..255 onto -1..1 (or the full int16 range) the same way
+// `raw/(255.0/2.0) - 1` always has.
+
+template <typename T>
+struct is_complex: std::false_type {};
+
+template <typename T>
+struct is_complex<std::complex<T>>: std::true_type {};
+
+template <typename T>
+struct sample_traits {
+	// Scalar type of one I or Q component
+	using scalar = T;
+};
+
+template <typename T>
+struct sample_traits<std::complex<T>> {
+	using scalar = T;
+};
+
+template <typename T>
+const std::array<T, 256>& u8_lut() {
+	// 256-entry table from raw ADC byte to component value, built once
+	static const std::array<T, 256> lut = []() {
+		std::array<T, 256> l;
+		for (int raw = 0; raw < 256; raw++) {
+			double v = raw/(255.0/2.0) - 1;
+
+			if constexpr (std::is_integral_v<T>) {
+				l[raw] = static_cast<T>(std::lround(v * std::numeric_limits<T>::max()));
+			}
+			else {
+				l[raw] = static_cast<T>(v);
+			}
+		}
+		return l;
+	}();
+
+	return lut;
+}
+
+namespace detail {
+
+inline std::size_t convert_f32_simd(const unsigned char* in, float* out, std::size_t n) {
+	// Widening kernel for the hot float path. Returns how many bytes it
+	// handled; the caller finishes the tail with the table.
+	std::size_t i = 0;
+
+#if defined(__AVX2__)
+	const __m256 scale = _mm256_set1_ps(2.0f/255.0f);
+	const __m256 offset = _mm256_set1_ps(-1.0f);
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		__m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(raw));
+		__m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(raw, 8)));
+
+		_mm256_storeu_ps(out + i,     _mm256_add_ps(_mm256_mul_ps(lo, scale), offset));
+		_mm256_storeu_ps(out + i + 8, _mm256_add_ps(_mm256_mul_ps(hi, scale), offset));
+	}
+#elif defined(__ARM_NEON)
+	const float32x4_t scale = vdupq_n_f32(2.0f/255.0f);
+	const float32x4_t offset = vdupq_n_f32(-1.0f);
+
+	for (; i + 16 <= n; i += 16) {
+		uint8x16_t raw = vld1q_u8(in + i);
+		uint16x8_t lo16 = vmovl_u8(vget_low_u8(raw));
+		uint16x8_t hi16 = vmovl_u8(vget_high_u8(raw));
+
+		float32x4_t a = vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo16)));
+		float32x4_t b = vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo16)));
+		float32x4_t c = vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi16)));
+		float32x4_t d = vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi16)));
+
+		vst1q_f32(out + i,      vmlaq_f32(offset, a, scale));
+		vst1q_f32(out + i + 4,  vmlaq_f32(offset, b, scale));
+		vst1q_f32(out + i + 8,  vmlaq_f32(offset, c, scale));
+		vst1q_f32(out + i + 12, vmlaq_f32(offset, d, scale));
+	}
+#else
+	(void)in;
+	(void)out;
+	(void)n;
+#endif
+
+	return i;
+}
+
+} // namespace detail
+
+template <typename T>
+void convert_samples(std::span<const unsigned char> bytes, std::span<T> out) {
+	// Converts raw dongle bytes into a presized output buffer
+	//
+	// Arguments:
+	//	bytes: Raw ADC bytes. Interleaved I/Q when T is complex, one real
+	//		sample per byte otherwise (direct sampling).
+	//	out: Destination; must hold at least `bytes.size()` real or
+	//		`bytes.size()/2` complex samples
+	//
+	// Notes:
+	//	Supported T: float, double, std::int16_t, and complex<float|double>.
+	//	complex<T> is laid out as two T's, so complex output is converted
+	//	as a flat run of components.
+	//
+	using scalar = typename sample_traits<T>::scalar;
+	static_assert(std::is_same_v<scalar, float> || std::is_same_v<scalar, double> ||
+		std::is_same_v<scalar, std::int16_t>, "Unsupported sample type");
+
+	constexpr std::size_t comps = is_complex<T>::value ? 2 : 1;
+	std::size_t n = (bytes.size() / comps) * comps;
+
+	if (out.size() * comps < n) {
+		throw std::length_error("convert_samples: output holds " + std::to_string(out.size()) +
+			" samples, need " + std::to_string(n / comps));
+	}
+
+	scalar* dst = reinterpret_cast<scalar*>(out.data());
+	const unsigned char* src = bytes.data();
+
+	std::size_t i = 0;
+	if constexpr (std::is_same_v<scalar, float>) {
+		i = detail::convert_f32_simd(src, dst, n);
+	}
+
+	const auto& lut = u8_lut<scalar>();
+	for (; i < n; i++) {
+		dst[i] = lut[src[i]];
+	}
+}
+
+} // namespace rtlsdr
+
+#endif
@@ -0,0 +1,309 @@
+#ifndef RTLSDRPP_DDC_HPP
+#define RTLSDRPP_DDC_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <span>
+#include <complex>
+#include <algorithm>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <cstdint>
+#include <cmath>
+
+namespace rtlsdr {
+
+template <typename T>
+std::vector<T> lowpass_taps(std::size_t num_taps, double cutoff) {
+	// Blackman-windowed sinc lowpass
+	//
+	// Arguments:
+	//	num_taps: Filter length
+	//	cutoff: -6 dB point as a fraction of the sample rate (0..0.5)
+	//
+	// Returns:
+	//	Taps normalized to unity gain at DC
+	//
+	// Notes:
+	//	A single tap has no window to speak of and comes back as {1}.
+	//
+	constexpr double pi = std::numbers::pi;
+
+	if (num_taps == 0) {
+		throw std::invalid_argument("lowpass_taps needs at least one tap");
+	}
+	if (num_taps == 1) {
+		return {T(1)};
+	}
+
+	std::vector<T> h(num_taps);
+	double mid = (num_taps - 1) / 2.0;
+	double sum = 0;
+
+	for (std::size_t n = 0; n < num_taps; n++) {
+		double x = n - mid;
+		double sinc = (x == 0) ? 2*cutoff : std::sin(2*pi*cutoff*x) / (pi*x);
+		double w = 0.42 - 0.5*std::cos(2*pi*n/(num_taps-1)) + 0.08*std::cos(4*pi*n/(num_taps-1));
+
+		h[n] = sinc * w;
+		sum += h[n];
+	}
+
+	for (auto& t: h) {
+		t /= sum;
+	}
+
+	return h;
+}
+
+template <typename T=float>
+class Ddc {
+	// Streaming digital down-converter: NCO mixer + polyphase FIR decimator
+	//
+	// Shifts `freq` down to 0 Hz, lowpass filters to the new Nyquist band
+	// and keeps every `decim`-th sample. Only the kept outputs are ever
+	// computed, so each one costs `taps_per_phase * decim` MACs; that's the
+	// polyphase decomposition without having to shuffle the taps.
+	//
+	// NCO phase, filter history and the decimation phase all persist across
+	// `process()` calls, so a stream can be fed in arbitrary block sizes and
+	// the output is identical to processing it in one go.
+	//
+	// Arguments:
+	//	sample_rate: Input rate, Hz
+	//	freq: Frequency to move to baseband, Hz, relative to the input's
+	//		0 Hz, i.e. the offset from the tuned center frequency. That holds
+	//		in direct-sampling mode too, where the center frequency sets the
+	//		RTL2832's IF.
+	//	decim: Decimation factor
+	//	taps_per_phase: FIR length per polyphase branch
+	//
+public:
+	using complex = std::complex<T>;
+
+	Ddc(double sample_rate, double freq, std::size_t decim_, std::size_t taps_per_phase=16):
+		fs(sample_rate), decim(decim_) {
+
+		if (decim == 0) {
+			throw std::invalid_argument("Ddc decimation must be at least 1");
+		}
+
+		// Pass band is 80% of the output Nyquist band, the rest is transition
+		taps = lowpass_taps<T>(taps_per_phase * decim, 0.4 / decim);
+		std::reverse(std::begin(taps), std::end(taps));
+
+		set_frequency(freq);
+		reset();
+	}
+
+	void set_frequency(double freq) {
+		// Retunes the NCO without disturbing filter state or its phase
+		f0 = freq;
+		double w = -2*std::numbers::pi * freq / fs;
+
+		for (std::size_t k = 0; k < NCO_LANES; k++) {
+			lane_rot[k] = std::polar(1.0, w*k);
+		}
+		step_re = std::cos(w*NCO_LANES);
+		step_im = std::sin(w*NCO_LANES);
+
+		load_lanes(std::complex<double>(lo_re[0], lo_im[0]));
+	}
+
+	void reset() {
+		load_lanes(1);
+		phase = 0;
+		hist_re.assign(taps.size() - 1, 0);
+		hist_im.assign(taps.size() - 1, 0);
+	}
+
+	double frequency() const { return f0; }
+	double output_rate() const { return fs / decim; }
+	std::size_t decimation() const { return decim; }
+
+	std::size_t max_output(std::size_t num_in) const {
+		// Upper bound on outputs produced by `num_in` more inputs
+		return (num_in + decim - 1) / decim;
+	}
+
+	std::size_t process(std::span<const T> in, std::span<complex> out) {
+		// Real input (direct sampling). Returns number of outputs written.
+		std::size_t base = stage(in.size(), out.size());
+
+		std::size_t n0 = 0;
+		for (; n0 + NCO_LANES <= in.size(); n0 += NCO_LANES) {
+			mix_real(&in[n0], base + n0, NCO_LANES);
+			advance(NCO_LANES);
+		}
+		if (n0 < in.size()) {
+			mix_real(&in[n0], base + n0, in.size() - n0);
+			advance(in.size() - n0);
+		}
+
+		return filter(in.size(), out);
+	}
+
+	std::size_t process(std::span<const complex> in, std::span<complex> out) {
+		// Complex I/Q input. Returns number of outputs written.
+		std::size_t base = stage(in.size(), out.size());
+
+		// std::complex<T> is guaranteed to be laid out as T[2]
+		const T* x = reinterpret_cast<const T*>(in.data());
+
+		std::size_t n0 = 0;
+		for (; n0 + NCO_LANES <= in.size(); n0 += NCO_LANES) {
+			mix_complex(x + 2*n0, base + n0, NCO_LANES);
+			advance(NCO_LANES);
+		}
+		if (n0 < in.size()) {
+			mix_complex(x + 2*n0, base + n0, in.size() - n0);
+			advance(in.size() - n0);
+		}
+
+		return filter(in.size(), out);
+	}
+
+private:
+	static constexpr std::size_t NCO_LANES = 8;
+
+	// The NCO is NCO_LANES oscillators, one per sample of a group, kept as
+	// separate real/imaginary arrays. Mixing a group and stepping every
+	// lane to the next group are then plain elementwise loops the compiler
+	// turns into packed multiplies.
+
+	void mix_real(const T* x, std::size_t at, std::size_t lanes) {
+		T* yr = &buf_re[at];
+		T* yi = &buf_im[at];
+		for (std::size_t k = 0; k < lanes; k++) {
+			yr[k] = x[k] * T(lo_re[k]);
+			yi[k] = x[k] * T(lo_im[k]);
+		}
+	}
+
+	void mix_complex(const T* x, std::size_t at, std::size_t lanes) {
+		// x is interleaved re/im
+		T* yr = &buf_re[at];
+		T* yi = &buf_im[at];
+		for (std::size_t k = 0; k < lanes; k++) {
+			T cr = T(lo_re[k]), ci = T(lo_im[k]);
+			yr[k] = x[2*k]*cr - x[2*k+1]*ci;
+			yi[k] = x[2*k]*ci + x[2*k+1]*cr;
+		}
+	}
+
+	void advance(std::size_t lanes) {
+		if (lanes < NCO_LANES) {
+			// Partial group, only at the end of a block: realign the lanes
+			load_lanes(std::complex<double>(lo_re[lanes - 1], lo_im[lanes - 1]) * lane_rot[1]);
+			return;
+		}
+
+		for (std::size_t k = 0; k < NCO_LANES; k++) {
+			double r = lo_re[k]*step_re - lo_im[k]*step_im;
+			double i = lo_re[k]*step_im + lo_im[k]*step_re;
+
+			// One Newton step towards |z| = 1, so rounding error can't grow
+			// the amplitude
+			double g = 1.5 - 0.5*(r*r + i*i);
+			lo_re[k] = r*g;
+			lo_im[k] = i*g;
+		}
+	}
+
+	void load_lanes(std::complex<double> z) {
+		// Sets lane 0 to z and the rest to the samples that follow it
+		for (std::size_t k = 0; k < NCO_LANES; k++) {
+			std::complex<double> v = z * lane_rot[k];
+			lo_re[k] = v.real();
+			lo_im[k] = v.imag();
+		}
+	}
+
+	std::size_t stage(std::size_t num_in, std::size_t out_size) {
+		// Lays out [history | new input] in the work buffers
+		std::size_t needed = (phase < num_in) ? (num_in - phase + decim - 1) / decim : 0;
+		if (out_size < needed) {
+			throw std::length_error("Ddc output holds " + std::to_string(out_size) +
+				" samples, need " + std::to_string(needed));
+		}
+
+		std::size_t hl = taps.size() - 1;
+		buf_re.resize(hl + num_in);
+		buf_im.resize(hl + num_in);
+
+		std::copy(std::begin(hist_re), std::end(hist_re), std::begin(buf_re));
+		std::copy(std::begin(hist_im), std::end(hist_im), std::begin(buf_im));
+
+		return hl;
+	}
+
+	std::size_t filter(std::size_t num_in, std::span<complex> out) {
+		std::size_t L = taps.size();
+		std::size_t hl = L - 1;
+		std::size_t n_out = 0;
+
+		// Output at buffer index b uses samples [b-L+1, b]
+		std::size_t b = hl + phase;
+		for (; b < hl + num_in; b += decim) {
+			const T* xr = &buf_re[b + 1 - L];
+			const T* xi = &buf_im[b + 1 - L];
+
+			T acc_r[4] = {0, 0, 0, 0}, acc_i[4] = {0, 0, 0, 0};
+			std::size_t k = 0;
+			for (; k + 4 <= L; k += 4) {
+				for (std::size_t j = 0; j < 4; j++) {
+					acc_r[j] += taps[k+j] * xr[k+j];
+					acc_i[j] += taps[k+j] * xi[k+j];
+				}
+			}
+			for (; k < L; k++) {
+				acc_r[0] += taps[k] * xr[k];
+				acc_i[0] += taps[k] * xi[k];
+			}
+
+			out[n_out++] = complex(acc_r[0] + acc_r[1] + acc_r[2] + acc_r[3],
+				acc_i[0] + acc_i[1] + acc_i[2] + acc_i[3]);
+		}
+		phase = b - (hl + num_in);
+
+		// Keep the newest L-1 mixed samples for the next call
+		std::copy(std::end(buf_re) - hl, std::end(buf_re), std::begin(hist_re));
+		std::copy(std::end(buf_im) - hl, std::end(buf_im), std::begin(hist_im));
+
+		return n_out;
+	}
+
+	double fs;
+	double f0 = 0;
+	std::size_t decim;
+	std::vector<T> taps; // time reversed
+
+	std::complex<double> lane_rot[NCO_LANES]; // e^(-jwk)
+	double step_re = 1, step_im = 0;          // e^(-jw*NCO_LANES)
+	double lo_re[NCO_LANES] = {1};            // current group's NCO values
+	double lo_im[NCO_LANES] = {};
+	std::size_t phase = 0; // inputs to skip before the next output
+
+	std::vector<T> hist_re, hist_im;
+	std::vector<T> buf_re, buf_im;
+};
+
+} // namespace rtlsdr
+
+#endif
@@ -0,0 +1,308 @@
+#ifndef RTLSDRPP_FFT_HPP
+#define RTLSDRPP_FFT_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <span>
+#include <complex>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <cstdint>
+#include <cmath>
+
+#include "aligned.hpp"
+
+namespace rtlsdr {
+
+inline bool is_pow2(std::size_t n) { return n != 0 && (n & (n - 1)) == 0; }
+
+inline bool has_fixed_kernels(std::size_t n) {
+	// Sizes with their own compiled copy of the hot loops, see
+	// detail::select_kernel
+	return is_pow2(n) && n >= 64 && n <= 8192;
+}
+
+namespace detail {
+
+template <template <std::size_t> class Kernel>
+auto select_kernel(std::size_t n) {
+	// Picks the copy of a kernel built for length `n`
+	//
+	// `Kernel<N>::run` takes the length at run time too, but for N != 0
+	// uses the constant instead, so the compiler sees fixed trip counts
+	// and strides (unrolled short stages, no bound reloads). N == 0 is the
+	// generic copy, for sizes without their own. Plans call this once
+	// when they're built and keep the pointer.
+	switch (n) {
+	case 64:   return &Kernel<64>::run;
+	case 128:  return &Kernel<128>::run;
+	case 256:  return &Kernel<256>::run;
+	case 512:  return &Kernel<512>::run;
+	case 1024: return &Kernel<1024>::run;
+	case 2048: return &Kernel<2048>::run;
+	case 4096: return &Kernel<4096>::run;
+	case 8192: return &Kernel<8192>::run;
+	default:   return &Kernel<0>::run;
+	}
+}
+
+template <typename T>
+struct Butterflies {
+	// Every radix-2 pass of an n point FFT, on interleaved re/im data
+	// already in bit reversed order
+	template <std::size_t N>
+	struct K {
+		static void run(T* d, const T* wr, const T* wi, std::size_t n_) {
+			// Complex products are spelled out; std::complex's operator*
+			// goes through a NaN-checking library call without -ffast-math
+			const std::size_t n = N ? N : n_;
+			std::size_t len = 2;
+
+			if (n >= 4) {
+				// The first two passes only multiply by 1 and -i; do them
+				// together as one radix-4 pass without the multiplies
+				for (std::size_t i = 0; i < 2*n; i += 8) {
+					T* x = d + i;
+					T a0r = x[0] + x[2], a0i = x[1] + x[3];
+					T a1r = x[0] - x[2], a1i = x[1] - x[3];
+					T a2r = x[4] + x[6], a2i = x[5] + x[7];
+					T a3r = x[4] - x[6], a3i = x[5] - x[7];
+
+					x[0] = a0r + a2r; x[1] = a0i + a2i;
+					x[4] = a0r - a2r; x[5] = a0i - a2i;
+					x[2] = a1r + a3i; x[3] = a1i - a3r; // a1 - i*a3
+					x[6] = a1r - a3i; x[7] = a1i + a3r;
+				}
+
+				wr += 3;
+				wi += 3;
+				len = 8;
+			}
+
+			for (; len <= n; len <<= 1) {
+				std::size_t half = len/2;
+
+				for (std::size_t i = 0; i < n; i += len) {
+					T* a = d + 2*i;
+					T* b = d + 2*(i + half);
+
+					for (std::size_t k = 0; k < half; k++) {
+						T br = b[2*k], bi = b[2*k + 1];
+						T tr = br*wr[k] - bi*wi[k];
+						T ti = br*wi[k] + bi*wr[k];
+
+						b[2*k]     = a[2*k] - tr;
+						b[2*k + 1] = a[2*k + 1] - ti;
+						a[2*k]     += tr;
+						a[2*k + 1] += ti;
+					}
+				}
+
+				wr += half;
+				wi += half;
+			}
+		}
+	};
+};
+
+template <typename T>
+struct RealSplit {
+	// Separates the half size complex FFT `z` of n real samples into
+	// their half spectrum `x`, bins 0..n/2
+	template <std::size_t N>
+	struct K {
+		static void run(const T* __restrict z, T* __restrict x, const T* wr, const T* wi, std::size_t n_) {
+			const std::size_t h = (N ? N : n_) / 2;
+
+			x[0] = z[0] + z[1];
+			x[1] = 0;
+			x[2*h] = z[0] - z[1];
+			x[2*h + 1] = 0;
+
+			// With A = Z[k] and B = conj(Z[h-k]):
+			//	even part E = (A + B)/2, odd part O = -i(A - B)/2
+			//	X[k] = E + w^k O
+			for (std::size_t k = 1; k < h; k++) {
+				T ar = z[2*k],       ai = z[2*k + 1];
+				T br = z[2*(h-k)],   bi = -z[2*(h-k) + 1];
+
+				T er = (ar + br) / 2, ei = (ai + bi) / 2;
+				T orr = (ai - bi) / 2, oi = (br - ar) / 2;
+
+				x[2*k]     = er + orr*wr[k] - oi*wi[k];
+				x[2*k + 1] = ei + orr*wi[k] + oi*wr[k];
+			}
+		}
+	};
+};
+
+} // namespace detail
+
+template <typename T=float>
+class FftPlan {
+	// Radix-2 complex FFT of one fixed power-of-two size
+	//
+	// Everything that depends only on the size (bit reversal order and
+	// the twiddles of every stage) is computed once here. The twiddles
+	// are stored stage by stage, so each butterfly pass reads its factors
+	// sequentially. Common sizes run butterflies compiled for that size
+	// (see has_fixed_kernels). A plan is read-only after construction and
+	// can be shared between threads.
+	//
+	// Arguments:
+	//	n: Transform length, a power of two
+	//
+public:
+	using complex = std::complex<T>;
+
+	FftPlan(std::size_t n_): n(n_) {
+		if (!is_pow2(n)) {
+			throw std::invalid_argument("FFT size " + std::to_string(n) + " is not a power of two");
+		}
+
+		butterflies = detail::select_kernel<detail::Butterflies<T>::template K>(n);
+
+		std::size_t bits = 0;
+		while ((std::size_t(1) << bits) < n) {
+			bits++;
+		}
+
+		rev.resize(n);
+		for (std::size_t i = 0; i < n; i++) {
+			std::size_t r = 0;
+			for (std::size_t b = 0; b < bits; b++) {
+				r |= ((i >> b) & 1) << (bits - 1 - b);
+			}
+			rev[i] = r;
+		}
+
+		// Stage with span `len` uses w^(k*n/len), k < len/2
+		for (std::size_t len = 2; len <= n; len <<= 1) {
+			for (std::size_t k = 0; k < len/2; k++) {
+				double a = -2*std::numbers::pi * k / len;
+				tw_re.push_back(std::cos(a));
+				tw_im.push_back(std::sin(a));
+			}
+		}
+	}
+
+	std::size_t size() const { return n; }
+
+	void forward(const complex* in, complex* out) const {
+		// Out of place; `in` and `out` must not overlap
+		for (std::size_t i = 0; i < n; i++) {
+			out[rev[i]] = in[i];
+		}
+
+		butterflies(reinterpret_cast<T*>(out), tw_re.data(), tw_im.data(), n);
+	}
+
+	void forward(complex* data) const {
+		// In place
+		for (std::size_t i = 0; i < n; i++) {
+			if (i < rev[i]) {
+				std::swap(data[i], data[rev[i]]);
+			}
+		}
+
+		butterflies(reinterpret_cast<T*>(data), tw_re.data(), tw_im.data(), n);
+	}
+
+private:
+	std::size_t n;
+	std::vector<std::size_t> rev;
+	aligned_vector<T> tw_re, tw_im;
+	void (*butterflies)(T*, const T*, const T*, std::size_t);
+};
+
+template <typename T=float>
+class RealFft {
+	// Forward FFT of real input, computing only the half spectrum
+	//
+	// The n real samples are treated as n/2 complex ones (even samples
+	// real, odd imaginary), transformed with a half-size complex FFT, and
+	// the two interleaved spectra separated afterwards. That's about half
+	// the work of a complex FFT of the zero-padded input, and the upper
+	// half of the spectrum (the mirror image) is never computed.
+	//
+	// The work buffer is owned by the object and reused, so `forward()`
+	// never allocates. Use one RealFft per thread.
+	//
+	// Arguments:
+	//	n: Number of real input samples, a power of two >= 2
+	//
+public:
+	using complex = std::complex<T>;
+
+	RealFft(std::size_t n_): n(n_), plan(half_size(n_)), work(n_/2) {
+		split = detail::select_kernel<detail::RealSplit<T>::template K>(n);
+
+		std::size_t h = n/2;
+		tw_re.resize(h);
+		tw_im.resize(h);
+		for (std::size_t k = 0; k < h; k++) {
+			double a = -2*std::numbers::pi * k / n;
+			tw_re[k] = std::cos(a);
+			tw_im[k] = std::sin(a);
+		}
+	}
+
+	std::size_t size() const { return n; }
+	std::size_t bins() const { return n/2 + 1; }
+
+	std::span<complex> forward(std::span<const T> in, std::span<complex> out) {
+		// Writes bins 0..n/2 (DC through Nyquist) of the DFT of `in`
+		//
+		// Returns:
+		//	span: The `bins()` outputs written
+		//
+		if (in.size() != n) {
+			throw std::length_error("RealFft input holds " + std::to_string(in.size()) +
+				" samples, plan is for " + std::to_string(n));
+		}
+		if (out.size() < bins()) {
+			throw std::length_error("RealFft output holds " + std::to_string(out.size()) +
+				" bins, need " + std::to_string(bins()));
+		}
+
+		plan.forward(reinterpret_cast<const complex*>(in.data()), work.data());
+		split(reinterpret_cast<const T*>(work.data()), reinterpret_cast<T*>(out.data()),
+			tw_re.data(), tw_im.data(), n);
+
+		return out.first(bins());
+	}
+
+private:
+	static std::size_t half_size(std::size_t n) {
+		if (n < 2 || !is_pow2(n)) {
+			throw std::invalid_argument("Real FFT size " + std::to_string(n) + " is not a power of two >= 2");
+		}
+		return n/2;
+	}
+
+	std::size_t n;
+	FftPlan<T> plan;
+	aligned_vector<complex> work;
+	aligned_vector<T> tw_re, tw_im;
+	void (*split)(const T*, T*, const T*, const T*, std::size_t);
+};
+
+} // namespace rtlsdr
+
+#endif
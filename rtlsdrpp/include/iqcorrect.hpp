@@ -0,0 +1,181 @@
+#ifndef RTLSDRPP_IQCORRECT_HPP
+#define RTLSDRPP_IQCORRECT_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <span>
+#include <complex>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+namespace rtlsdr {
+
+// Time constant of the running estimates, in samples (~27 ms at 2.4 MS/s)
+const double DEFAULT_IQ_TAU = 65536;
+
+template <typename T=float>
+class IqCorrector {
+	// Streaming DC offset and I/Q imbalance removal
+	//
+	// The RTL2832's ADCs sit slightly off 127.5 and the I and Q paths
+	// differ a little in gain and phase. Uncorrected, that leaves a spike
+	// at 0 Hz and a mirror image of every signal across it.
+	//
+	// Each block updates running estimates of the DC offset and of the
+	// I/Q second moments, then the block is corrected in place:
+	//
+	//	I' = I - dc_i
+	//	Q' = (Q - dc_q - rho*I') * g
+	//
+	// where rho = E[IQ]/E[I^2] takes out the phase error and g rescales Q
+	// to the same power as I (Gram-Schmidt orthogonalization). The per
+	// sample work is one affine map, so the loops vectorize.
+	//
+	// Arguments:
+	//	tau: Time constant of the estimates, in samples. The first block
+	//		seeds them directly, so there's no start-up transient.
+	//
+	// Notes:
+	//	Real input (direct sampling) only gets the DC correction.
+	//
+public:
+	using complex = std::complex<T>;
+
+	IqCorrector(double tau_=DEFAULT_IQ_TAU): tau(tau_) {
+		if (tau <= 0) {
+			throw std::invalid_argument("IqCorrector time constant must be positive");
+		}
+	}
+
+	void reset() {
+		seeded = false;
+		dc_i = dc_q = 0;
+		p_ii = p_qq = 1;
+		p_iq = 0;
+	}
+
+	std::complex<double> dc_offset() const { return {dc_i, dc_q}; }
+
+	double gain_imbalance() const {
+		// Q/I amplitude ratio
+		return std::sqrt(p_qq / p_ii);
+	}
+
+	double phase_imbalance() const {
+		// Deviation from quadrature, radians
+		return std::asin(std::clamp(p_iq / std::sqrt(p_ii * p_qq), -1.0, 1.0));
+	}
+
+	void process(std::span<T> x) {
+		// Real samples: removes DC in place
+		if (x.empty()) {
+			return;
+		}
+
+		double acc[4] = {0, 0, 0, 0};
+		std::size_t body = x.size() - x.size() % 4;
+		for (std::size_t n = 0; n < body; n += 4) {
+			for (std::size_t j = 0; j < 4; j++) {
+				acc[j] += x[n+j];
+			}
+		}
+		for (std::size_t n = body; n < x.size(); n++) {
+			acc[0] += x[n];
+		}
+
+		double a = weight(x.size());
+		dc_i += a * ((acc[0] + acc[1] + acc[2] + acc[3]) / x.size() - dc_i);
+
+		T off = dc_i;
+		for (auto& v: x) {
+			v -= off;
+		}
+	}
+
+	void process(std::span<complex> x) {
+		// Complex I/Q: removes DC and balances I against Q in place
+		if (x.empty()) {
+			return;
+		}
+
+		T* s = reinterpret_cast<T*>(x.data());
+		std::size_t len = x.size();
+
+		// Block means first, then the central moments about them
+		double si = 0, sq = 0;
+		for (std::size_t k = 0; k < len; k++) {
+			si += s[2*k];
+			sq += s[2*k + 1];
+		}
+
+		double a = weight(len);
+		dc_i += a * (si / len - dc_i);
+		dc_q += a * (sq / len - dc_q);
+
+		double mi = si / len, mq = sq / len;
+		double ii = 0, qq = 0, iq = 0;
+		for (std::size_t k = 0; k < len; k++) {
+			double i = s[2*k] - mi;
+			double q = s[2*k + 1] - mq;
+			ii += i*i;
+			qq += q*q;
+			iq += i*q;
+		}
+
+		p_ii += a * (ii / len - p_ii);
+		p_qq += a * (qq / len - p_qq);
+		p_iq += a * (iq / len - p_iq);
+
+		// A dead or saturated input leaves nothing to balance against
+		double rho = 0, g = 1;
+		double resid = p_qq - p_iq*p_iq / p_ii;
+		if (p_ii > 0 && resid > 0) {
+			rho = p_iq / p_ii;
+			g = std::sqrt(p_ii / resid);
+		}
+
+		T oi = dc_i, oq = dc_q, r = rho, gq = g;
+		for (std::size_t k = 0; k < len; k++) {
+			T i = s[2*k] - oi;
+			T q = s[2*k + 1] - oq;
+			s[2*k] = i;
+			s[2*k + 1] = (q - r*i) * gq;
+		}
+	}
+
+private:
+	double weight(std::size_t n) {
+		// Smoothing factor for a block of n samples
+		if (!seeded) {
+			seeded = true;
+			return 1;
+		}
+
+		return 1 - std::exp(-static_cast<double>(n) / tau);
+	}
+
+	double tau;
+	bool seeded = false;
+
+	double dc_i = 0, dc_q = 0;
+	double p_ii = 1, p_qq = 1, p_iq = 0;
+};
+
+} // namespace rtlsdr
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef RTLSDRPP_PANORAMA_HPP
+#define RTLSDRPP_PANORAMA_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <cstdint>
+#include <cmath>
+
+namespace rtlsdr {
+
+class Panorama {
+	// Stitches the per-step spectra of a sweep into one wideband spectrum
+	//
+	// Every step's spectrum is placed on a common frequency grid with the
+	// same bin width, at the offset its center frequency puts it. The
+	// band edges of each step (filter roll-off, and DC for real input) are
+	// trimmed first. Where steps overlap, the grid holds the mean of the
+	// bins landing on it. Placement only depends on the plan, so it's
+	// worked out once in `set_plan()`; stitching is then contiguous adds
+	// and one multiply per grid bin.
+	//
+	// Max and min hold track each grid bin across stitches until
+	// `reset_holds()`.
+	//
+	// Arguments:
+	//	bin_hz: Width of one spectrum bin
+	//	bins: Bins per step spectrum
+	//	ref_bin: Bin that sits at the step's center frequency (0 for the
+	//		half spectrum of real samples, bins/2 for a shifted complex one)
+	//	trim: Fraction of the bins dropped at each edge of every step
+	//
+public:
+	Panorama(double bin_hz_, std::size_t bins_, std::size_t ref_bin_=0, double trim=0.05):
+		bin_hz(bin_hz_), bins(bins_), ref_bin(ref_bin_) {
+
+		if (bin_hz <= 0 || bins == 0) {
+			throw std::invalid_argument("Panorama needs a positive bin width and bin count");
+		}
+		if (trim < 0 || trim >= 0.5) {
+			throw std::invalid_argument("Panorama trim must be in [0, 0.5)");
+		}
+
+		first = std::lround(bins * trim);
+		if (2*first >= bins) {
+			throw std::invalid_argument("Panorama trim leaves no bins");
+		}
+		kept = bins - 2*first;
+	}
+
+	void set_plan(const std::vector<std::uint32_t>& freqs) {
+		// Lays the grid out for a sweep over `freqs`; clears the holds
+		if (freqs.empty()) {
+			throw std::invalid_argument("Panorama plan is empty");
+		}
+
+		auto lo_edge = [&](std::uint32_t fc) { return fc + (double(first) - double(ref_bin)) * bin_hz; };
+
+		auto [fmin, fmax] = std::minmax_element(std::begin(freqs), std::end(freqs));
+		grid_lo = lo_edge(*fmin);
+		std::size_t size = std::lround((lo_edge(*fmax) - grid_lo) / bin_hz) + kept;
+
+		offsets.resize(freqs.size());
+		std::vector<std::uint32_t> count(size, 0);
+		for (std::size_t s = 0; s < freqs.size(); s++) {
+			offsets[s] = std::min<std::size_t>(std::lround((lo_edge(freqs[s]) - grid_lo) / bin_hz), size - kept);
+			for (std::size_t i = 0; i < kept; i++) {
+				count[offsets[s] + i]++;
+			}
+		}
+
+		inv_count.resize(size);
+		for (std::size_t g = 0; g < size; g++) {
+			// Bins no step reaches stay at zero
+			inv_count[g] = count[g] ? 1.0f / count[g] : 0.0f;
+		}
+
+		sum.assign(size, 0);
+		reset_holds();
+	}
+
+	std::size_t size() const { return sum.size(); }
+	std::size_t steps() const { return offsets.size(); }
+	double freq(std::size_t g) const { return grid_lo + g*bin_hz; }
+
+	void stitch(std::span<const float> step_spectra) {
+		// Builds the panorama from one sweep
+		//
+		// Arguments:
+		//	step_spectra: `steps()` spectra of `bins` bins each, back to
+		//		back in plan order
+		//
+		if (step_spectra.size() < steps() * bins) {
+			throw std::length_error("Panorama needs " + std::to_string(steps()) + " spectra of " +
+				std::to_string(bins) + " bins");
+		}
+
+		std::fill(std::begin(sum), std::end(sum), 0);
+
+		for (std::size_t s = 0; s < steps(); s++) {
+			const float* __restrict src = step_spectra.data() + s*bins + first;
+			float* __restrict dst = sum.data() + offsets[s];
+			for (std::size_t i = 0; i < kept; i++) {
+				dst[i] += src[i];
+			}
+		}
+
+		for (std::size_t g = 0; g < sum.size(); g++) {
+			float v = sum[g] * inv_count[g];
+			sum[g] = v;
+			hi_hold[g] = std::max(hi_hold[g], v);
+			lo_hold[g] = std::min(lo_hold[g], v);
+		}
+	}
+
+	std::span<const float> spectrum() const { return sum; }
+	std::span<const float> max_hold() const { return hi_hold; }
+	std::span<const float> min_hold() const { return lo_hold; }
+
+	void reset_holds() {
+		hi_hold.assign(sum.size(), -std::numeric_limits<float>::infinity());
+		lo_hold.assign(sum.size(), std::numeric_limits<float>::infinity());
+	}
+
+	static void downsample(std::span<const float> in, std::span<float> out) {
+		// Averages `in` down to `out.size()` evenly spread groups (or
+		// repeats bins, if `out` is the larger one), for feature vectors
+		// of a fixed width
+		std::size_t n = in.size(), m = out.size();
+		if (n == 0) {
+			std::fill(std::begin(out), std::end(out), 0);
+			return;
+		}
+
+		for (std::size_t j = 0; j < m; j++) {
+			std::size_t a = j*n / m, b = std::max((j+1)*n / m, a + 1);
+
+			float acc = 0;
+			for (std::size_t i = a; i < b; i++) {
+				acc += in[i];
+			}
+			out[j] = acc / (b - a);
+		}
+	}
+
+	void features(std::span<float> out) const { downsample(sum, out); }
+
+private:
+	double bin_hz;
+	std::size_t bins;
+	std::size_t ref_bin;
+	std::size_t first; // first bin kept after trimming
+	std::size_t kept;  // bins kept per step
+
+	double grid_lo = 0;
+	std::vector<std::size_t> offsets; // grid index of each step's first kept bin
+	std::vector<float> inv_count;
+
+	std::vector<float> sum;
+	std::vector<float> hi_hold, lo_hold;
+};
+
+} // namespace rtlsdr
+
+#endif
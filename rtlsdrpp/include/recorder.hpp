@@ -0,0 +1,378 @@
+#ifndef RTLSDRPP_RECORDER_HPP
+#define RTLSDRPP_RECORDER_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <string>
+#include <span>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <fstream>
+#include <exception>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "rtlsdrpp.hpp"
+#include "ringbuffer.hpp"
+
+namespace rtlsdr {
+
+// Large chunks keep the writer down to one syscall per MiB
+const std::size_t DEFAULT_RECORD_CHUNK = 1 << 20;
+const std::size_t DEFAULT_RECORD_CHUNKS = 32;
+
+class IqRecorder {
+	// Streams raw u8 I/Q to disk as a SigMF recording
+	//
+	// Writes `<base>.sigmf-data` (the bytes exactly as the dongle produced
+	// them, SigMF datatype `cu8`) and, on `close()`, `<base>.sigmf-meta`
+	// with the sample rate and one capture segment (frequency, gain) per
+	// retune or gap.
+	//
+	// Data is staged in a preallocated BlockRing of large, page-aligned
+	// chunks and written out by a background thread, so the capture side
+	// only ever does a memcpy (or none at all, via `record()`).
+	//
+	// Arguments:
+	//	base_path (str): Output path without extension
+	//	chunk_bytes: Size of each write(), a multiple of 4096
+	//	num_chunks: Chunks that may be queued before the producer waits
+	//
+public:
+	IqRecorder(const std::string& base_path, std::size_t chunk_bytes=DEFAULT_RECORD_CHUNK,
+		std::size_t num_chunks=DEFAULT_RECORD_CHUNKS):
+
+		base(base_path), ring(check_chunk(chunk_bytes), num_chunks) {
+
+		std::string data_path = base + ".sigmf-data";
+		fd = ::open(data_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			throw std::runtime_error("Could not create \"" + data_path + "\": " + std::strerror(errno));
+		}
+
+		writer = std::thread([this]() { write_loop(); });
+	}
+
+	IqRecorder(const IqRecorder&) = delete;
+	IqRecorder& operator=(const IqRecorder&) = delete;
+
+	~IqRecorder() {
+		try {
+			close();
+		}
+		catch (...) {}
+	}
+
+	void set_sample_rate(std::uint32_t rate) { sample_rate = rate; }
+	void set_gain(int gain_db) { gain = gain_db; }
+	void set_hw(const std::string& hw_) { hw = hw_; }
+
+	void mark_retune(std::uint32_t freq) {
+		// Starts a new SigMF capture segment with the next byte passed to
+		// `write()`, so call it between the last write at the old frequency
+		// and the first at the new one. `record()` finds retunes itself.
+		open_capture({queued/2, freq, gain, std::nullopt, std::chrono::system_clock::now()});
+	}
+
+	void set_from(SdrBackend& sdr) {
+		// Pulls rate and frequency from a backend and opens a capture
+		set_sample_rate(sdr.get_sample_rate());
+		mark_retune(sdr.get_center_freq());
+	}
+
+	void write(std::span<const unsigned char> bytes) {
+		// Queues bytes for the writer thread, waiting if it's a full ring
+		// behind. Rethrows the writer's error once it has failed.
+		check_writer();
+
+		while (!bytes.empty()) {
+			unsigned char* slot = next_slot();
+			std::size_t n = std::min(bytes.size(), ring.block_size() - fill);
+
+			std::memcpy(slot + fill, bytes.data(), n);
+			fill += n;
+			queued += n;
+			bytes = bytes.subspan(n);
+
+			if (fill == ring.block_size()) {
+				commit_slot();
+			}
+		}
+	}
+
+	template <typename Stream=RtlSdr>
+	std::size_t record(Stream& sdr, std::size_t num_bytes) {
+		// Moves `num_bytes` from a running async stream straight into the
+		// recorder's chunks, without an intermediate copy
+		//
+		// Capture segments come from the stream's block stamps rather than
+		// from the caller: one starts wherever the center frequency changed
+		// or sample_index jumped (blocks dropped on overrun), with the
+		// block's own time and core:global_index set to its sample_index.
+		//
+		// Arguments:
+		//	sdr: An RtlSdr after `start_stream()`, or anything else with its
+		//		`read_stream_block()`
+		//
+		// Returns:
+		//	Bytes recorded; short only if the stream stopped
+		//
+		check_writer();
+
+		std::size_t done = 0;
+		while (done < num_bytes) {
+			unsigned char* slot = next_slot();
+			std::size_t want = std::min(num_bytes - done, ring.block_size() - fill);
+
+			BlockInfo info;
+			std::size_t n = sdr.read_stream_block(slot + fill, want, &info);
+			if (n == 0) {
+				break;
+			}
+			note_block(info, n);
+
+			fill += n;
+			queued += n;
+			done += n;
+
+			if (fill == ring.block_size()) {
+				commit_slot();
+			}
+		}
+
+		return done;
+	}
+
+	std::uint64_t bytes_queued() const { return queued; }
+	std::uint64_t bytes_written() const { return written.load(std::memory_order_relaxed); }
+
+	void close() {
+		// Flushes everything, stops the writer and writes the metadata
+		if (fd < 0) {
+			return;
+		}
+
+		if (fill > 0) {
+			commit_slot();
+		}
+
+		stopping.store(true, std::memory_order_release);
+		ring.wake();
+		writer.join();
+
+		::close(fd);
+		fd = -1;
+
+		write_meta();
+
+		if (write_error) {
+			std::rethrow_exception(write_error);
+		}
+	}
+
+private:
+	struct Capture {
+		std::uint64_t sample_start;
+		std::uint32_t freq;
+		int gain;
+		std::optional<std::uint64_t> global_index; // sample_index in the source stream
+		std::chrono::system_clock::time_point time;
+	};
+
+	static std::size_t check_chunk(std::size_t chunk_bytes) {
+		if (chunk_bytes == 0 || chunk_bytes % PAGE_ALIGN != 0) {
+			throw std::invalid_argument("IqRecorder chunk size must be a nonzero multiple of " +
+				std::to_string(PAGE_ALIGN) + " bytes");
+		}
+		return chunk_bytes;
+	}
+
+	void open_capture(const Capture& c) {
+		// A segment nothing was recorded into is replaced, not kept
+		if (!captures.empty() && captures.back().sample_start == c.sample_start) {
+			captures.back() = c;
+		}
+		else {
+			captures.push_back(c);
+		}
+	}
+
+	void note_block(const BlockInfo& info, std::size_t n) {
+		// Opens a segment if this block doesn't carry straight on from the
+		// last one recorded
+		const TunerState& t = info.tuner;
+		bool continues = streamed && info.sample_index == next_index &&
+			t.retunes == last_retunes && t.center_freq == last_freq;
+
+		if (!continues) {
+			// host_ns is CLOCK_MONOTONIC; SigMF wants wall-clock time
+			auto age = std::chrono::nanoseconds(monotonic_ns() - info.host_ns);
+			auto when = std::chrono::system_clock::now() - std::chrono::duration_cast<std::chrono::system_clock::duration>(age);
+			open_capture({queued/2, t.center_freq, t.gain, info.sample_index, when});
+		}
+
+		streamed = true;
+		next_index = info.sample_index + n/2;
+		last_retunes = t.retunes;
+		last_freq = t.center_freq;
+	}
+
+	void check_writer() {
+		if (failed.load(std::memory_order_acquire)) {
+			std::rethrow_exception(write_error);
+		}
+	}
+
+	unsigned char* next_slot() {
+		if (current == nullptr) {
+			// Sleep until the writer frees a chunk, or fails
+			ring.wait_until([this]() {
+				return ring.size() < ring.capacity() || failed.load(std::memory_order_acquire);
+			});
+			check_writer();
+
+			current = ring.write_slot();
+			fill = 0;
+		}
+
+		return current;
+	}
+
+	void commit_slot() {
+		ring.commit(fill);
+		current = nullptr;
+		fill = 0;
+	}
+
+	void write_loop() {
+		while (true) {
+			std::size_t len;
+			const unsigned char* chunk = ring.front(&len);
+
+			if (chunk == nullptr) {
+				if (stopping.load(std::memory_order_acquire) && ring.empty()) {
+					return;
+				}
+				ring.wait_until([this]() { return !ring.empty() || stopping.load(std::memory_order_acquire); });
+				continue;
+			}
+
+			std::size_t off = 0;
+			while (off < len) {
+				ssize_t r = ::write(fd, chunk + off, len - off);
+				if (r < 0) {
+					if (errno == EINTR) {
+						continue;
+					}
+					write_error = std::make_exception_ptr(std::runtime_error(
+						"Write to \"" + base + ".sigmf-data\" failed: " + std::strerror(errno)));
+					failed.store(true, std::memory_order_release);
+					ring.wake();
+					return;
+				}
+				off += r;
+			}
+
+			written.fetch_add(len, std::memory_order_relaxed);
+			ring.pop();
+		}
+	}
+
+	void write_meta() {
+		std::ofstream fout(base + ".sigmf-meta");
+
+		fout << "{\n"
+		     << "  \"global\": {\n"
+		     << "    \"core:datatype\": \"cu8\",\n"
+		     << "    \"core:sample_rate\": " << sample_rate << ",\n"
+		     << "    \"core:version\": \"1.0.0\",\n"
+		     << "    \"core:recorder\": \"rtlsdrpp\"";
+		if (!hw.empty()) {
+			fout << ",\n    \"core:hw\": \"" << hw << "\"";
+		}
+		fout << "\n  },\n"
+		     << "  \"captures\": [";
+
+		for (std::size_t i = 0; i < captures.size(); i++) {
+			const auto& c = captures[i];
+			fout << (i ? ",\n" : "\n")
+			     << "    {\"core:sample_start\": " << c.sample_start
+			     << ", \"core:frequency\": " << c.freq;
+			if (c.global_index) {
+				fout << ", \"core:global_index\": " << *c.global_index;
+			}
+			fout << ", \"core:datetime\": \"" << iso8601(c.time) << "\""
+			     << ", \"rtlsdrpp:gain\": " << c.gain << "}";
+		}
+
+		fout << "\n  ],\n"
+		     << "  \"annotations\": []\n"
+		     << "}\n";
+	}
+
+	static std::string iso8601(std::chrono::system_clock::time_point now) {
+		std::time_t t = std::chrono::system_clock::to_time_t(now);
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count() % 1000000;
+
+		std::tm tm;
+		gmtime_r(&t, &tm);
+
+		char bfr[64];
+		std::size_t n = std::strftime(bfr, sizeof(bfr), "%Y-%m-%dT%H:%M:%S", &tm);
+		std::snprintf(bfr + n, sizeof(bfr) - n, ".%06ldZ", static_cast<long>(us));
+
+		return bfr;
+	}
+
+	std::string base;
+	int fd = -1;
+
+	BlockRing ring;
+	unsigned char* current = nullptr;
+	std::size_t fill = 0;
+	std::uint64_t queued = 0;
+
+	bool streamed = false;         // record() has stamped a block
+	std::uint64_t next_index = 0;  // sample_index that would continue it
+	std::uint32_t last_retunes = 0;
+	std::uint32_t last_freq = 0;
+
+	std::thread writer;
+	std::atomic<bool> stopping{false};
+	std::atomic<std::uint64_t> written{0};
+	std::exception_ptr write_error; // set by the writer before `failed`
+	std::atomic<bool> failed{false};
+
+	std::uint32_t sample_rate = DEFAULT_RS;
+	int gain = DEFAULT_GAIN;
+	std::string hw;
+	std::vector<Capture> captures;
+};
+
+} // namespace rtlsdr
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef RTLSDRPP_RINGBUFFER_HPP
+#define RTLSDRPP_RINGBUFFER_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "aligned.hpp"
+
+namespace rtlsdr {
+
+const std::size_t CACHE_LINE_SIZE = 64;
+
+class BlockRing {
+	// Single-producer/single-consumer ring of fixed size byte blocks
+	//
+	// All storage is allocated up front, so neither side ever touches the
+	// heap once the ring is constructed. The producer (the librtlsdr USB
+	// thread) only writes `head`, the consumer only writes `tail`, and each
+	// index lives on its own cache line so the two threads don't fight
+	// over it.
+	//
+	// Notes:
+	//	Capacity is rounded up to a power of two so indices can be masked
+	//	instead of taken modulo. `head - tail` is the fill level, so every
+	//	slot is usable.
+	//
+	//	Storage is page aligned, so with a block size that's a multiple of
+	//	4096 every block can go straight to write(), O_DIRECT included.
+	//
+	//	Either side can sleep until the other makes progress with
+	//	`wait_until()`: every commit, pop and clear bumps an event counter
+	//	and wakes whoever is blocked on it (a futex, so no syscall when
+	//	nobody is).
+	//
+public:
+	BlockRing(std::size_t block_size, std::size_t num_blocks) {
+		if (block_size == 0 || num_blocks == 0) {
+			throw std::invalid_argument("BlockRing needs a nonzero block size and count");
+		}
+
+		std::size_t cap = 1;
+		while (cap < num_blocks) {
+			cap <<= 1;
+		}
+
+		blk_size = block_size;
+		mask = cap - 1;
+		storage.resize(cap * block_size);
+		lengths.resize(cap);
+	}
+
+	BlockRing(const BlockRing&) = delete;
+	BlockRing& operator=(const BlockRing&) = delete;
+
+	std::size_t block_size() const { return blk_size; }
+	std::size_t capacity() const { return mask + 1; }
+
+	std::size_t size() const {
+		return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+	}
+
+	bool empty() const { return size() == 0; }
+
+	// Sequence numbers of the next block to be written (producer side) and
+	// read (consumer side). `seq & (capacity()-1)` indexes any per-slot side
+	// table the owner keeps in step with the ring.
+	std::size_t write_index() const { return head.load(std::memory_order_relaxed); }
+	std::size_t read_index() const { return tail.load(std::memory_order_relaxed); }
+
+	///////////////////////////////////////////////////////////
+	// Producer side
+	///////////////////////////////////////////////////////////
+
+	unsigned char* write_slot() {
+		// Returns the next free block, or nullptr if the ring is full.
+		// Fill it, then call `commit()`.
+		std::size_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) > mask) {
+			return nullptr;
+		}
+
+		return &storage[(h & mask) * blk_size];
+	}
+
+	void commit(std::size_t len) {
+		std::size_t h = head.load(std::memory_order_relaxed);
+		lengths[h & mask] = len;
+		head.store(h + 1, std::memory_order_release);
+		wake();
+	}
+
+	bool push(const unsigned char* data, std::size_t len) {
+		// Copies one block in. Returns false (and drops the data) when
+		// the consumer has fallen a full ring behind.
+		if (len > blk_size) {
+			len = blk_size;
+		}
+
+		unsigned char* slot = write_slot();
+		if (slot == nullptr) {
+			return false;
+		}
+
+		std::memcpy(slot, data, len);
+		commit(len);
+		return true;
+	}
+
+	///////////////////////////////////////////////////////////
+	// Consumer side
+	///////////////////////////////////////////////////////////
+
+	const unsigned char* front(std::size_t* len=nullptr) const {
+		// Returns the oldest filled block, or nullptr if the ring is empty.
+		// The block stays valid until `pop()`.
+		std::size_t t = tail.load(std::memory_order_relaxed);
+		if (head.load(std::memory_order_acquire) == t) {
+			return nullptr;
+		}
+
+		if (len != nullptr) {
+			*len = lengths[t & mask];
+		}
+
+		return &storage[(t & mask) * blk_size];
+	}
+
+	void pop() {
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		wake();
+	}
+
+	void clear() {
+		// Consumer side only; discards everything currently queued
+		tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+		wake();
+	}
+
+	///////////////////////////////////////////////////////////
+	// Waiting
+	///////////////////////////////////////////////////////////
+
+	template <typename Pred>
+	void wait_until(Pred ready) {
+		// Sleeps until `ready()` is true. It's re-checked after every ring
+		// event, so it can test the ring (`!empty()`, `size() < n`) and any
+		// flag whose writer calls `wake()` after setting it.
+		while (true) {
+			std::uint32_t seen = events.load(std::memory_order_seq_cst);
+			if (ready()) {
+				return;
+			}
+			events.wait(seen, std::memory_order_seq_cst);
+		}
+	}
+
+	void wake() {
+		// Wakes every `wait_until()` so it re-checks its condition
+		events.fetch_add(1, std::memory_order_seq_cst);
+		events.notify_all();
+	}
+
+private:
+	std::size_t blk_size;
+	std::size_t mask;
+	page_aligned_vector<unsigned char> storage;
+	std::vector<std::size_t> lengths;
+
+	alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> head{0};
+	alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> tail{0};
+	alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> events{0};
+};
+
+} // namespace rtlsdr
+
+#endif
@@ -19,14 +19,25 @@
 
 #include <vector>
 #include <map>
+#include <optional>
 #include <string>
+#include <span>
 #include <complex>
 #include <exception>
 #include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <cstring>
 #include <cstdint>
 #include <cmath>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <ctime>
 
 #include "rtl-sdr.h"
+#include "ringbuffer.hpp"
+#include "convert.hpp"
 
 namespace rtlsdr {
 
@@ -35,6 +46,10 @@ const std::uint32_t DEFAULT_FC = 80e6;
 const std::uint32_t DEFAULT_RS = 1.024e6;
 const int DEFAULT_READ_SIZE = 1024;
 
+const std::uint32_t DEFAULT_ASYNC_BUF_LEN = 16*16384; // must be a multiple of 512
+const std::uint32_t DEFAULT_ASYNC_BUF_NUM = 15;        // USB transfers in flight
+const std::size_t DEFAULT_RING_BLOCKS = 64;
+
 const long CRYSTAL_FREQ = 28800000;
 
 const std::map<int, std::string> errno_map = {
@@ -115,13 +130,211 @@ std::vector<std::string> get_device_serial_addresses() {
 	return addresses;
 }
 
-class BaseRtlSdr {
+struct TunerState {
+	std::uint32_t center_freq = 0;
+	std::uint32_t sample_rate = 0;
+	int gain = 0;
+	int direct_sampling = 0;
+	std::uint32_t retunes = 0; // bumped on every center freq change
+};
+
+struct TunerConfig {
+	// Settings to apply in one go; unset fields are left alone
+	std::optional<std::uint32_t> center_freq;
+	std::optional<std::uint32_t> sample_rate;
+	std::optional<int> gain;
+	std::optional<int> direct_sampling;
+};
+
+struct BlockInfo {
+	// Where and when a block of samples came from
+	std::uint64_t sample_index = 0; // first I/Q sample of the block, counted from open/start
+	std::uint64_t host_ns = 0;      // CLOCK_MONOTONIC when the block reached the host
+	TunerState tuner;               // tuner settings in effect at that moment
+};
+
+inline std::uint64_t monotonic_ns() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+class SdrBackend {
+	// Common interface for anything that produces dongle-format samples
+	//
+	// The real device (BaseRtlSdr), file replay (ReplaySdr) and synthetic
+	// signals (SyntheticSdr) all implement the same small set of tuning
+	// calls plus `read_bytes()`. Everything built on top of raw bytes
+	// (views, sample conversion) lives here once.
+	//
+	// Every backend also shadows its tuner settings and stamps each read
+	// with a BlockInfo, available from `last_block()` until the next read.
+	// The shadow is atomic per field so a capture thread can snapshot it
+	// while another thread retunes.
+	//
+public:
+	virtual ~SdrBackend() = default;
+
+	virtual void set_center_freq(std::uint32_t freq) = 0;
+	virtual std::uint32_t get_center_freq() = 0;
+	virtual void set_sample_rate(std::uint32_t rate) = 0;
+	virtual std::uint32_t get_sample_rate() = 0;
+	virtual void set_gain(int gain) = 0;
+	virtual void set_direct_sampling(int direct) = 0;
+
+	virtual std::vector<int> gain_steps() {
+		// Manual gain settings in dB, ascending; empty if there's no gain
+		// control. 0 is never included since `set_gain(0)` means AGC.
+		return {};
+	}
+
+	virtual std::span<unsigned char> read_bytes(std::span<unsigned char> dest) = 0;
+
+	virtual std::span<const unsigned char> read_bytes_view(std::size_t num_bytes=DEFAULT_READ_SIZE) {
+		// Reads into the backend's persistent buffer and returns a view of it
+		//
+		// Notes:
+		//	The view is only valid until the next read on this backend. The
+		//	buffer only ever grows, so repeated reads of the same size never
+		//	touch the heap.
+		//
+		if (buffer.size() < num_bytes) {
+			buffer.resize(num_bytes);
+		}
+
+		return read_bytes(std::span<unsigned char>(buffer.data(), num_bytes));
+	}
+
+	std::vector<unsigned char> read_bytes(std::size_t num_bytes=DEFAULT_READ_SIZE) {
+		auto raw_data = read_bytes_view(num_bytes);
+		return std::vector<unsigned char>(std::begin(raw_data), std::end(raw_data));
+	}
+
+	template <typename T=std::complex<double>>
+	std::vector<T> read_samples(std::size_t num_samples) {
+		std::size_t num_bytes = 2*num_samples;
+		auto raw_data = read_bytes_view(num_bytes);
+
+		return packed_bytes_to_iq<T>(raw_data);
+	}
+	
+	template <typename T=double>
+	std::vector<T> read_samples_direct(std::size_t num_samples) {
+		std::vector<T> samples(num_samples);
+		auto raw_data = read_bytes_view(num_samples);
+		
+		convert_samples<T>(raw_data, samples);
+		
+		return samples;
+	}
+
+	template <typename T=std::complex<double>>
+	std::vector<T> packed_bytes_to_iq(std::span<const unsigned char> bytes) {
+		std::vector<T> iq(bytes.size()/2);
+		convert_samples<T>(bytes, iq);
+
+		return iq;
+	}
+
+	// Caller-supplied buffer overloads. These fill `out` completely and
+	// never allocate once the backend's byte buffer has grown to size.
+
+	template <typename T>
+	std::span<T> read_samples(std::span<T> out) {
+		convert_samples<T>(read_bytes_view(2*out.size()), out);
+		return out;
+	}
+
+	template <typename T>
+	std::span<T> read_samples_direct(std::span<T> out) {
+		convert_samples<T>(read_bytes_view(out.size()), out);
+		return out;
+	}
+
+	template <typename T>
+	std::span<T> packed_bytes_to_iq(std::span<const unsigned char> bytes, std::span<T> out) {
+		convert_samples<T>(bytes, out);
+		return out.first(bytes.size()/2);
+	}
+
+	void configure(const TunerConfig& cfg) {
+		// Applies every field of `cfg` that is set. Direct sampling goes
+		// first since it changes what the tuner is doing, gain last.
+		if (cfg.direct_sampling) set_direct_sampling(*cfg.direct_sampling);
+		if (cfg.sample_rate) set_sample_rate(*cfg.sample_rate);
+		if (cfg.center_freq) set_center_freq(*cfg.center_freq);
+		if (cfg.gain) set_gain(*cfg.gain);
+	}
+
+	TunerState tuner_state() const {
+		return {
+			st_fc.load(std::memory_order_relaxed),
+			st_rate.load(std::memory_order_relaxed),
+			st_gain.load(std::memory_order_relaxed),
+			st_direct.load(std::memory_order_relaxed),
+			st_retunes.load(std::memory_order_relaxed)
+		};
+	}
+
+	const BlockInfo& last_block() const { return last_info; }
+	std::uint64_t samples_read() const { return bytes_read/2; }
+
+protected:
+	void note_center_freq(std::uint32_t freq) {
+		st_fc.store(freq, std::memory_order_relaxed);
+		st_retunes.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void note_sample_rate(std::uint32_t rate) { st_rate.store(rate, std::memory_order_relaxed); }
+	void note_gain(int gain) { st_gain.store(gain, std::memory_order_relaxed); }
+	void note_direct_sampling(int direct) { st_direct.store(direct, std::memory_order_relaxed); }
+
+	void stamp(std::size_t num_bytes) {
+		// Call once per completed read, after the data has arrived
+		last_info = {bytes_read/2, monotonic_ns(), tuner_state()};
+		bytes_read += num_bytes;
+	}
+
+	std::vector<unsigned char> buffer;
+
+private:
+	std::atomic<std::uint32_t> st_fc{0};
+	std::atomic<std::uint32_t> st_rate{0};
+	std::atomic<int> st_gain{0};
+	std::atomic<int> st_direct{0};
+	std::atomic<std::uint32_t> st_retunes{0};
+
+	BlockInfo last_info;
+	std::uint64_t bytes_read = 0;
+};
+
+class BaseRtlSdr: public SdrBackend {
+	// Synchronous access to one dongle
+	//
+	// Every setter remembers what it last wrote, and writing the same value
+	// again returns without a USB control transfer. Sweeps that revisit
+	// frequencies, or configuration code that re-applies its settings,
+	// only pay for real changes.
+	//
+	// Arguments:
+	//	index: Device index, ignored if `serial_number` is given
+	//	test_mode_enabled: Have the RTL2832 output a counter instead of samples
+	//	serial_number (str): Open the dongle with this serial
+	//	initial: Settings to open with; anything unset gets the library
+	//		default (DEFAULT_RS, DEFAULT_FC, DEFAULT_GAIN). Each is written
+	//		once, instead of a default followed by an override.
+	//
 public:
-	BaseRtlSdr(std::uint32_t index=0, bool test_mode_enabled=false, const std::string& serial_number="") {
-		open(index, test_mode_enabled, serial_number);
+	using SdrBackend::read_bytes;
+
+	BaseRtlSdr(std::uint32_t index=0, bool test_mode_enabled=false, const std::string& serial_number="",
+		const TunerConfig& initial={}) {
+
+		open(index, test_mode_enabled, serial_number, initial);
 	}
 
-	void open(std::uint32_t index=0, bool test_mode_enabled=false, const std::string& serial_number="") {
+	void open(std::uint32_t index=0, bool test_mode_enabled=false, const std::string& serial_number="",
+		const TunerConfig& initial={}) {
 		if (serial_number != "") {
 			index = get_device_index_by_serial(serial_number);
 		}
@@ -145,42 +358,55 @@ public:
 		}
 
 		device_opened = true;
-		init_device_values();
+		init_device_values(initial);
 	}
 
-	void init_device_values() {
+	void init_device_values(const TunerConfig& initial={}) {
 		gain_values = get_gains();
 		valid_gains_db.resize(gain_values.size());
 		std::transform(
 			std::begin(gain_values), std::end(gain_values), std::begin(valid_gains_db),
 			[](int gain_val) { return gain_val/10.0; }
 		);
-	
-		set_sample_rate(DEFAULT_RS);
-		set_center_freq(DEFAULT_FC);
-		set_gain(DEFAULT_GAIN);
+
+		TunerConfig cfg = initial;
+		if (!cfg.sample_rate) cfg.sample_rate = DEFAULT_RS;
+		if (!cfg.center_freq) cfg.center_freq = DEFAULT_FC;
+		if (!cfg.gain) cfg.gain = DEFAULT_GAIN;
+
+		configure(cfg);
 	}
 
-	void close() {
+	virtual void close() {
 		if (!device_opened) {
 			return;
 		}
 
 		rtlsdr_close(dev_p);
 		device_opened = false;
+
+		// A reopened device starts from its own defaults
+		known = 0;
 	}
 
-	~BaseRtlSdr() { close(); }
+	~BaseRtlSdr() override { close(); }
 	
-	void set_center_freq(std::uint32_t freq) {
+	void set_center_freq(std::uint32_t freq) override {
+		if (tuned_to(freq)) {
+			return;
+		}
+
 		int result = rtlsdr_set_center_freq(dev_p, freq);
 		if (result < 0) {
 			close();
 			throw LibUSBException(result, "Could not set center freq to " + std::to_string(freq) + " Hz");
 		}
+
+		note_center_freq(freq);
+		known |= KNOWN_FC;
 	}
 
-	std::uint32_t get_center_freq() {
+	std::uint32_t get_center_freq() override {
 		std::uint32_t result = rtlsdr_get_center_freq(dev_p);
 		if (result == 0) {
 			close();
@@ -208,15 +434,22 @@ public:
 		return result;
 	}
 
-	void set_sample_rate(std::uint32_t rate) {
+	void set_sample_rate(std::uint32_t rate) override {
+		if ((known & KNOWN_RATE) && tuner_state().sample_rate == rate) {
+			return;
+		}
+
 		int result = rtlsdr_set_sample_rate(dev_p, rate);
 		if (result < 0) {
 			close();
 			throw LibUSBException(result, "Could not set sample rate to " + std::to_string(rate) + " Hz");
 		}
+
+		note_sample_rate(rate);
+		known |= KNOWN_RATE;
 	}
 
-	std::uint32_t get_sample_rate() {
+	std::uint32_t get_sample_rate() override {
 		std::uint32_t result = rtlsdr_get_sample_rate(dev_p);
 		if (result == 0) {
 			close();
@@ -239,29 +472,43 @@ public:
 		}
 	}
 
-	void set_gain(int gain) {
+	void set_gain(int gain) override {
+		// Gain in dB, snapped to the nearest step the tuner has; 0 = AGC.
+		// Requests that snap to the step already set cost nothing.
 		if (gain == 0) {
-			set_manual_gain_enabled(false);
+			if (!(known & KNOWN_GAIN) || manual_gain) {
+				set_manual_gain_enabled(false);
+				manual_gain = false;
+			}
+
+			note_gain(0);
+			known |= KNOWN_GAIN;
 			return;
 		}
 
-		set_manual_gain_enabled(true);
-
-		std::vector<int> errors(gain_values.size());
-		std::transform(
-			std::begin(gain_values), std::end(gain_values), std::begin(errors),
-			[&](int g) { return std::abs(10*gain - g); }
+		int nearest = *std::min_element(std::begin(gain_values), std::end(gain_values),
+			[&](int a, int b) { return std::abs(10*gain - a) < std::abs(10*gain - b); }
 		);
 
-		auto nearest_gain_ind = std::distance(
-			std::begin(errors), std::min_element(std::begin(errors), std::end(errors))
-		);
+		if ((known & KNOWN_GAIN) && manual_gain && nearest == tuner_gain) {
+			note_gain(gain);
+			return;
+		}
 
-		int result = rtlsdr_set_tuner_gain(dev_p, gain_values[nearest_gain_ind]);
+		if (!(known & KNOWN_GAIN) || !manual_gain) {
+			set_manual_gain_enabled(true);
+			manual_gain = true;
+		}
+
+		int result = rtlsdr_set_tuner_gain(dev_p, nearest);
 		if (result < 0) {
 			close();
 			throw LibUSBException(result, "Could not set gain to " + std::to_string(gain));
 		}
+
+		tuner_gain = nearest;
+		note_gain(gain);
+		known |= KNOWN_GAIN;
 	}
 
 	int get_gain() {
@@ -274,6 +521,19 @@ public:
 		return result/10;
 	}
 
+	std::vector<int> gain_steps() override {
+		// Tuner gains rounded to the whole dB `set_gain()` takes
+		std::vector<int> steps;
+		for (int g: gain_values) {
+			int db = std::lround(g/10.0);
+			if (db > 0 && (steps.empty() || steps.back() != db)) {
+				steps.push_back(db);
+			}
+		}
+
+		return steps;
+	}
+
 	std::vector<int> get_gains() {
 		int buffer[50];
 		int result = rtlsdr_get_tuner_gains(dev_p, buffer);
@@ -301,24 +561,34 @@ public:
 		}
 	}
 
-	void set_direct_sampling(int direct) {
+	void set_direct_sampling(int direct) override {
 		// 0 = disabled, 1 = I ADC, 2 = Q ADC
+		if ((known & KNOWN_DIRECT) && tuner_state().direct_sampling == direct) {
+			return;
+		}
+
 		int result = rtlsdr_set_direct_sampling(dev_p, direct);
 		if (result < 0) {
 			close();
 			throw LibUSBException(result, "Could not set direct sampling");
-		}	
+		}
+
+		note_direct_sampling(direct);
+		known |= KNOWN_DIRECT;
 	}
 
 	int get_tuner_type() { return (int)rtlsdr_get_tuner_type(dev_p); }
 
-	std::vector<unsigned char> read_bytes(std::size_t num_bytes=DEFAULT_READ_SIZE) {
-		if (buffer.size() != num_bytes) {
-			buffer.resize(num_bytes);
-		}
-		
+	std::span<unsigned char> read_bytes(std::span<unsigned char> dest) override {
+		// Reads `dest.size()` bytes straight into caller-owned storage
+		//
+		// Returns:
+		//	span: `dest`, for chaining
+		//
+		std::size_t num_bytes = dest.size();
+
 		int n_read;
-		int result = rtlsdr_read_sync(dev_p, buffer.data(), num_bytes, &n_read);
+		int result = rtlsdr_read_sync(dev_p, dest.data(), num_bytes, &n_read);
 
 		if (result < 0) {
 			close();
@@ -331,38 +601,371 @@ public:
 				", received " + std::to_string(n_read) + " bytes");
 		}
 
-		return buffer;
+		stamp(num_bytes);
+		return dest;
 	}
 
-	std::vector<std::complex<double>> read_samples(std::size_t num_samples) {
-		std::size_t num_bytes = 2*num_samples;
-		auto raw_data = read_bytes(num_bytes);
+protected:
+	bool tuned_to(std::uint32_t freq) const {
+		// True if a retune to `freq` would be a no-op
+		return (known & KNOWN_FC) && tuner_state().center_freq == freq;
+	}
 
-		return packed_bytes_to_iq(raw_data);
+	rtlsdr_dev* dev_p;
+	bool device_opened;
+
+private:
+	// Which of the shadowed settings are known to match the hardware
+	enum : unsigned {
+		KNOWN_FC = 1,
+		KNOWN_RATE = 2,
+		KNOWN_GAIN = 4,
+		KNOWN_DIRECT = 8
+	};
+
+	std::vector<int> gain_values;
+	std::vector<double> valid_gains_db;
+
+	unsigned known = 0;
+	bool manual_gain = false;
+	int tuner_gain = 0; // tenths of a dB, as librtlsdr takes it
+};
+
+struct StreamStats {
+	// Snapshot of RtlSdr's streaming counters
+	std::uint64_t blocks_delivered = 0; // USB transfers queued for the consumer
+	std::uint64_t blocks_dropped = 0;   // transfers thrown away because the ring was full
+	std::uint64_t bytes_delivered = 0;
+	std::uint64_t bytes_dropped = 0;
+	std::uint64_t late_consumer = 0;    // transfers that found the ring over 3/4 full
+	std::size_t max_fill = 0;           // ring high-water mark, in blocks
+	std::uint64_t consumer_waits = 0;   // times read_stream() found the ring empty
+	std::uint64_t retunes = 0;
+	std::uint64_t retune_stalls = 0;    // retunes that took longer than one transfer
+	std::uint64_t retune_ns_total = 0;
+	std::uint64_t retune_ns_max = 0;
+
+	bool gapless() const { return blocks_dropped == 0; }
+};
+
+class RtlSdr: public BaseRtlSdr {
+	// Adds a streaming mode on top of BaseRtlSdr
+	//
+	// `start_stream()` hands the device to `rtlsdr_read_async` on a
+	// dedicated thread. Every USB transfer is copied into a preallocated
+	// BlockRing; readers drain it with `read_stream()` without ever taking
+	// a lock, so DSP work on the consumer side no longer stalls the dongle.
+	//
+	// Notes:
+	//	While streaming, the synchronous `read_bytes()`/`read_samples()`
+	//	calls must not be used; librtlsdr only allows one reader at a time.
+	//	If the consumer falls a full ring behind, incoming blocks are
+	//	dropped rather than blocking the USB thread. `stream_stats()` says
+	//	whether that happened, so callers can tell gapless data from
+	//	data with holes in it.
+	//
+public:
+	using BaseRtlSdr::BaseRtlSdr;
+
+	~RtlSdr() override { stop_stream(); }
+
+	void start_stream(std::uint32_t block_len=DEFAULT_ASYNC_BUF_LEN, 
+		std::size_t num_blocks=DEFAULT_RING_BLOCKS, std::uint32_t num_transfers=DEFAULT_ASYNC_BUF_NUM) {
+
+		if (streaming()) {
+			return;
+		}
+
+		// A stream that ended on its own (USB error, unplug) leaves its
+		// thread to be joined and its result to be reported
+		stop_stream();
+		int last = stream_result.exchange(0, std::memory_order_relaxed);
+		if (last < 0) {
+			throw LibUSBException(last, "Previous async stream stopped with an error");
+		}
+
+		if (block_len == 0 || block_len % 512 != 0) {
+			throw std::invalid_argument("Async block length must be a nonzero multiple of 512");
+		}
+
+		int result = rtlsdr_reset_buffer(dev_p);
+		if (result < 0) {
+			throw LibUSBException(result, "Could not reset buffer");
+		}
+
+		if (!ring || ring->block_size() != block_len || ring->capacity() < num_blocks) {
+			ring = std::make_unique<BlockRing>(block_len, num_blocks);
+		}
+		ring->clear();
+		stream_meta.resize(ring->capacity());
+		stream_bytes = 0;
+		block_offset = 0;
+		stream_block_len = block_len;
+		reset_stream_stats();
+
+		stream_result.store(0, std::memory_order_relaxed);
+		running.store(true, std::memory_order_release);
+
+		stream_thread = std::thread([this, block_len, num_transfers]() {
+			int r = rtlsdr_read_async(dev_p, &RtlSdr::async_callback, this, num_transfers, block_len);
+			stream_result.store(r, std::memory_order_relaxed);
+			running.store(false, std::memory_order_release);
+
+			// A reader asleep in read_stream() has to see the stream end
+			ring->wake();
+		});
 	}
 
-	std::vector<std::complex<double>> packed_bytes_to_iq(const std::vector<unsigned char>& bytes) {
-		std::vector<std::complex<double>> iq;
+	void stop_stream() {
+		if (!stream_thread.joinable()) {
+			return;
+		}
 
-		for (std::size_t i = 0; i < bytes.size()-1; i+=2) {
-			iq.emplace_back(bytes[i]/(255.0/2.0) -1, bytes[i+1]/(255.0/2.0) -1);
+		// A cancel issued before rtlsdr_read_async has spun up is ignored
+		// by librtlsdr, so keep asking until the reader thread is done
+		while (running.load(std::memory_order_acquire)) {
+			rtlsdr_cancel_async(dev_p);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
 		}
 
-		return iq;
+		stream_thread.join();
+	}
+
+	bool streaming() const { return running.load(std::memory_order_acquire); }
+
+	void close() override {
+		// The reader thread must be off the device before it's freed; the
+		// setters close on error, possibly mid-stream
+		stop_stream();
+		BaseRtlSdr::close();
+	}
+
+	std::size_t get_dropped_blocks() const { return ctr.blocks_dropped.load(std::memory_order_relaxed); }
+
+	void set_center_freq(std::uint32_t freq) override {
+		// Times the retune; while streaming, a control transfer that takes
+		// longer than one USB transfer's worth of samples is a stall
+		if (tuned_to(freq)) {
+			return;
+		}
+
+		std::uint64_t t0 = monotonic_ns();
+		BaseRtlSdr::set_center_freq(freq);
+		std::uint64_t dt = monotonic_ns() - t0;
+
+		ctr.retunes.fetch_add(1, std::memory_order_relaxed);
+		ctr.retune_ns_total.fetch_add(dt, std::memory_order_relaxed);
+
+		std::uint64_t prev = ctr.retune_ns_max.load(std::memory_order_relaxed);
+		while (dt > prev && !ctr.retune_ns_max.compare_exchange_weak(prev, dt, std::memory_order_relaxed));
+
+		std::uint32_t rate = tuner_state().sample_rate;
+		if (streaming() && rate > 0 && dt > 1000000000ull * (stream_block_len/2) / rate) {
+			ctr.retune_stalls.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	StreamStats stream_stats() const {
+		// Counters since the last start_stream()/reset; safe to call from
+		// any thread while streaming
+		StreamStats st;
+		st.blocks_delivered = ctr.blocks_delivered.load(std::memory_order_relaxed);
+		st.blocks_dropped   = ctr.blocks_dropped.load(std::memory_order_relaxed);
+		st.bytes_delivered  = ctr.bytes_delivered.load(std::memory_order_relaxed);
+		st.bytes_dropped    = ctr.bytes_dropped.load(std::memory_order_relaxed);
+		st.late_consumer    = ctr.late_consumer.load(std::memory_order_relaxed);
+		st.max_fill         = ctr.max_fill.load(std::memory_order_relaxed);
+		st.consumer_waits   = ctr.consumer_waits.load(std::memory_order_relaxed);
+		st.retunes          = ctr.retunes.load(std::memory_order_relaxed);
+		st.retune_stalls    = ctr.retune_stalls.load(std::memory_order_relaxed);
+		st.retune_ns_total  = ctr.retune_ns_total.load(std::memory_order_relaxed);
+		st.retune_ns_max    = ctr.retune_ns_max.load(std::memory_order_relaxed);
+		return st;
+	}
+
+	void reset_stream_stats() {
+		ctr.blocks_delivered.store(0, std::memory_order_relaxed);
+		ctr.blocks_dropped.store(0, std::memory_order_relaxed);
+		ctr.bytes_delivered.store(0, std::memory_order_relaxed);
+		ctr.bytes_dropped.store(0, std::memory_order_relaxed);
+		ctr.late_consumer.store(0, std::memory_order_relaxed);
+		ctr.max_fill.store(0, std::memory_order_relaxed);
+		ctr.consumer_waits.store(0, std::memory_order_relaxed);
+		ctr.retunes.store(0, std::memory_order_relaxed);
+		ctr.retune_stalls.store(0, std::memory_order_relaxed);
+		ctr.retune_ns_total.store(0, std::memory_order_relaxed);
+		ctr.retune_ns_max.store(0, std::memory_order_relaxed);
+	}
+
+	std::size_t read_stream(unsigned char* dest, std::size_t num_bytes, BlockInfo* info=nullptr) {
+		// Copies the next `num_bytes` of the stream into `dest`, waiting on
+		// the USB thread as needed. Partial blocks are remembered, so
+		// consecutive calls see a continuous byte stream.
+		//
+		// If `info` is given it receives the stamp of the first byte copied.
+		// Its sample_index counts every sample the dongle delivered,
+		// including blocks dropped on overrun, so a gap in the stream shows
+		// up as a jump in sample_index.
+		//
+		// Returns:
+		//	The number of bytes copied; only less than `num_bytes` if the
+		//	stream stopped underneath us. A stream that stopped on a USB
+		//	error throws once what it delivered has been read.
+		//
+		std::size_t copied = 0;
+		while (copied < num_bytes) {
+			std::size_t n = read_stream_block(dest + copied, num_bytes - copied, copied == 0 ? info : nullptr);
+			if (n == 0) {
+				break;
+			}
+			copied += n;
+		}
+
+		return copied;
+	}
+
+	std::size_t read_stream_block(unsigned char* dest, std::size_t max_bytes, BlockInfo* info=nullptr) {
+		// Like `read_stream()`, but stops at the end of the current USB
+		// block, so `info` describes every byte copied: they're contiguous
+		// samples taken at one tuning. Waits only if nothing is buffered.
+		//
+		// Returns:
+		//	The number of bytes copied, at most `max_bytes`; 0 once the
+		//	stream has stopped and been drained
+		//
+		if (!ring) {
+			throw std::logic_error("read_stream() called before start_stream()");
+		}
+
+		if (max_bytes == 0) {
+			return 0;
+		}
+
+		std::size_t len;
+		const unsigned char* blk;
+		while ((blk = ring->front(&len)) == nullptr) {
+			if (!streaming() && ring->empty()) {
+				int r = stream_result.load(std::memory_order_relaxed);
+				if (r < 0) {
+					throw LibUSBException(r, "Async stream stopped with an error");
+				}
+				return 0;
+			}
+
+			// Sleep until the USB thread commits a block or stops, rather
+			// than holding a core for the transfer latency
+			ctr.consumer_waits.fetch_add(1, std::memory_order_relaxed);
+			ring->wait_until([this]() { return !ring->empty() || !streaming(); });
+		}
+
+		if (info != nullptr) {
+			*info = stream_meta[ring->read_index() & (ring->capacity() - 1)];
+			info->sample_index += block_offset/2;
+		}
+
+		std::size_t n = std::min(len - block_offset, max_bytes);
+		std::memcpy(dest, blk + block_offset, n);
+		block_offset += n;
+
+		if (block_offset == len) {
+			ring->pop();
+			block_offset = 0;
+		}
+
+		return n;
+	}
+
+	template <typename T=std::complex<double>>
+	std::vector<T> read_samples_stream(std::size_t num_samples) {
+		std::vector<unsigned char> raw_data(2*num_samples);
+		raw_data.resize(read_stream(raw_data.data(), raw_data.size()));
+
+		return packed_bytes_to_iq<T>(raw_data);
+	}
+
+	template <typename T>
+	std::span<T> read_samples_stream(std::span<T> out) {
+		// Streams into `out`, staging the raw bytes in the persistent buffer
+		if (buffer.size() < 2*out.size()) {
+			buffer.resize(2*out.size());
+		}
+
+		std::size_t n = read_stream(buffer.data(), 2*out.size());
+		return packed_bytes_to_iq<T>(std::span<const unsigned char>(buffer.data(), n), out);
+	}
+
+	void flush_stream() {
+		// Throws away everything buffered so far, e.g. right after a retune
+		if (ring) {
+			ring->clear();
+		}
+		block_offset = 0;
 	}
 
 private:
-	rtlsdr_dev* dev_p;
-	bool device_opened;
+	static void async_callback(unsigned char* buf, std::uint32_t len, void* ctx) {
+		auto self = static_cast<RtlSdr*>(ctx);
+		auto& ring = *self->ring;
 
-	std::vector<int> gain_values;
-	std::vector<double> valid_gains_db;
-	std::vector<unsigned char> buffer;
-};
+		BlockInfo info = {self->stream_bytes/2, monotonic_ns(), self->tuner_state()};
+		self->stream_bytes += len;
 
-// TODO Add async
-class RtlSdr: public BaseRtlSdr {
-	
+		auto& ctr = self->ctr;
+
+		std::size_t seq = ring.write_index();
+		unsigned char* slot = ring.write_slot();
+		if (slot == nullptr) {
+			ctr.blocks_dropped.fetch_add(1, std::memory_order_relaxed);
+			ctr.bytes_dropped.fetch_add(len, std::memory_order_relaxed);
+			return;
+		}
+
+		std::size_t n = std::min<std::size_t>(len, ring.block_size());
+		std::memcpy(slot, buf, n);
+		self->stream_meta[seq & (ring.capacity() - 1)] = info;
+		ring.commit(n);
+
+		// Only this thread writes these, so plain load/store is enough
+		std::size_t fill = ring.size();
+		if (fill > ctr.max_fill.load(std::memory_order_relaxed)) {
+			ctr.max_fill.store(fill, std::memory_order_relaxed);
+		}
+		if (4*fill > 3*ring.capacity()) {
+			ctr.late_consumer.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		ctr.blocks_delivered.fetch_add(1, std::memory_order_relaxed);
+		ctr.bytes_delivered.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	struct Counters {
+		// Written by the USB thread
+		std::atomic<std::uint64_t> blocks_delivered{0};
+		std::atomic<std::uint64_t> blocks_dropped{0};
+		std::atomic<std::uint64_t> bytes_delivered{0};
+		std::atomic<std::uint64_t> bytes_dropped{0};
+		std::atomic<std::uint64_t> late_consumer{0};
+		std::atomic<std::size_t> max_fill{0};
+
+		// Written by the consumer / control threads
+		alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> consumer_waits{0};
+		std::atomic<std::uint64_t> retunes{0};
+		std::atomic<std::uint64_t> retune_stalls{0};
+		std::atomic<std::uint64_t> retune_ns_total{0};
+		std::atomic<std::uint64_t> retune_ns_max{0};
+	};
+
+	std::unique_ptr<BlockRing> ring;
+	std::vector<BlockInfo> stream_meta; // stamps, parallel to the ring's slots
+	std::uint64_t stream_bytes = 0;     // USB thread only
+	std::size_t block_offset = 0;
+
+	std::thread stream_thread;
+	std::atomic<bool> running{false};
+	std::atomic<int> stream_result{0};
+	std::uint32_t stream_block_len = DEFAULT_ASYNC_BUF_LEN;
+
+	Counters ctr;
 };
 	
 } // namespace rtlsdr
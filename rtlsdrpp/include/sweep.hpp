@@ -0,0 +1,299 @@
+#ifndef RTLSDRPP_SWEEP_HPP
+#define RTLSDRPP_SWEEP_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <span>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "rtlsdrpp.hpp"
+#include "ringbuffer.hpp"
+
+namespace rtlsdr {
+
+// Bytes thrown away after every retune while the tuner PLL locks and stale
+// transfers drain out of the USB pipe (~1.7 ms of I/Q at 2.4 MS/s)
+const std::size_t DEFAULT_SETTLE_BYTES = 8192;
+
+inline std::vector<std::uint32_t> log_sweep(double flo, double fhi, std::size_t nsteps) {
+	// Geometrically spaced center frequencies, both ends included
+	// (nsteps + 1 of them, like linear_sweep)
+	//
+	// Notes:
+	//	Each step is computed from its index rather than by repeated
+	//	multiplication, so the endpoint doesn't depend on rounding. That
+	//	is the plan the server's original float loop produced for its
+	//	default sweep (500 kHz to 1.75 MHz, 128 steps: 129 frequencies).
+	//
+	if (flo <= 0 || fhi < flo || nsteps == 0) {
+		throw std::invalid_argument("log_sweep needs 0 < flo <= fhi and at least one step");
+	}
+
+	std::vector<std::uint32_t> freqs(nsteps + 1);
+	for (std::size_t i = 0; i <= nsteps; i++) {
+		freqs[i] = std::lround(flo * std::pow(fhi/flo, double(i)/nsteps));
+	}
+
+	return freqs;
+}
+
+inline std::vector<std::uint32_t> linear_sweep(double flo, double fhi, std::size_t nsteps) {
+	// Evenly spaced center frequencies, both ends included
+	std::vector<std::uint32_t> freqs(nsteps + 1);
+	for (std::size_t i = 0; i <= nsteps; i++) {
+		freqs[i] = flo + (fhi - flo) * i / nsteps;
+	}
+
+	return freqs;
+}
+
+struct SweepBlock {
+	std::size_t step;     // index into the frequency plan
+	std::uint32_t freq;   // center frequency it was tuned to
+	BlockInfo info;       // sample index, host time, tuner state
+	std::span<const unsigned char> bytes;
+};
+
+struct SweepTiming {
+	// Where the time of one `SweepScheduler::run()` went
+	std::uint64_t wall_ns = 0;
+	std::uint64_t capture_ns = 0;      // retune + settle + read, capture thread
+	std::uint64_t process_ns = 0;      // inside the block callback, caller's thread
+	std::size_t capture_stalls = 0;    // steps where capture waited for a free slot
+	std::size_t consumer_stalls = 0;   // steps where the callback waited for data
+
+	double overlap() const {
+		// 1 when wall time is max(capture, process), 0 when it's their sum
+		std::uint64_t lo = std::min(capture_ns, process_ns);
+		if (lo == 0) {
+			return 1;
+		}
+		double saved = static_cast<double>(capture_ns + process_ns) - static_cast<double>(wall_ns);
+		return std::clamp(saved / lo, 0.0, 1.0);
+	}
+};
+
+class SweepScheduler {
+	// Walks a frequency plan on one backend with the retune pipelined
+	//
+	// A capture thread retunes, throws away `settle_bytes` while the PLL
+	// locks, then reads the block into a small BlockRing. The caller's
+	// thread consumes blocks as they arrive, so the USB control transfer
+	// and read for step k+1 overlap whatever the caller does with step k.
+	//
+	// The capture thread is started by the first `run()` and then parked
+	// on the ring between runs, so a sweep costs no thread creation.
+	//
+	// Arguments:
+	//	sdr: Backend to sweep; must not be used by anyone else during `run()`
+	//	freqs: Center frequency plan, visited in order
+	//	block_bytes: Bytes kept per step
+	//	settle_bytes: Bytes discarded after each retune
+	//	depth: Blocks in flight at once, the one being processed included
+	//		(2 = double buffer, 3 = triple, for callbacks whose cost varies
+	//		from step to step). At least 2; with 1 capture and processing
+	//		would just take turns.
+	//
+	// Notes:
+	//	`timing()` reports how much of the last run was overlapped, and
+	//	which side had to wait on the other.
+	//
+public:
+	SweepScheduler(SdrBackend& sdr_, std::vector<std::uint32_t> freqs_, std::size_t block_bytes,
+		std::size_t settle_bytes_=DEFAULT_SETTLE_BYTES, std::size_t depth=2):
+
+		sdr(sdr_), freqs(std::move(freqs_)), settle_bytes(settle_bytes_), pipeline_depth(depth),
+		ring(block_bytes, checked_depth(depth)), meta(ring.capacity()) {}
+
+	SweepScheduler(const SweepScheduler&) = delete;
+	SweepScheduler& operator=(const SweepScheduler&) = delete;
+
+	~SweepScheduler() {
+		if (capture.joinable()) {
+			shutdown.store(true, std::memory_order_release);
+			ring.wake();
+			capture.join();
+		}
+	}
+
+	const std::vector<std::uint32_t>& plan() const { return freqs; }
+	std::size_t block_bytes() const { return ring.block_size(); }
+	std::size_t settle() const { return settle_bytes; }
+	std::size_t depth() const { return pipeline_depth; }
+
+	const SweepTiming& timing() const { return stats; }
+
+	template <typename It>
+	void set_plan(It first, It last) {
+		// Swaps in a new plan, reusing the old one's storage
+		freqs.assign(first, last);
+	}
+
+	template <typename Fn>
+	void run(Fn on_block) {
+		// Calls `on_block(const SweepBlock&)` once per step, in plan order.
+		// The block's bytes are only valid for the duration of the call.
+		ring.clear();
+		abort.store(false, std::memory_order_relaxed);
+		capture_done.store(false, std::memory_order_relaxed);
+		capture_error = nullptr;
+		stats = {};
+
+		std::uint64_t t_start = monotonic_ns();
+		if (!capture.joinable()) {
+			capture = std::thread([this]() { capture_thread(); });
+		}
+		runs.fetch_add(1, std::memory_order_release);
+		ring.wake();
+
+		try {
+			for (std::size_t step = 0; step < freqs.size(); step++) {
+				// Sleep until capture commits the block (or gives up)
+				bool waited = ring.empty();
+				ring.wait_until([this]() {
+					return !ring.empty() || capture_done.load(std::memory_order_acquire);
+				});
+
+				std::size_t len;
+				const unsigned char* blk = ring.front(&len);
+				if (blk == nullptr) {
+					break; // capture died; rethrown below
+				}
+				stats.consumer_stalls += waited;
+
+				SweepBlock b = meta[step & (ring.capacity() - 1)];
+				b.bytes = std::span<const unsigned char>(blk, len);
+
+				std::uint64_t t0 = monotonic_ns();
+				on_block(b);
+				stats.process_ns += monotonic_ns() - t0;
+
+				ring.pop();
+			}
+		}
+		catch (...) {
+			abort.store(true, std::memory_order_relaxed);
+			ring.wake();
+			wait_capture();
+			throw;
+		}
+
+		wait_capture();
+		stats.wall_ns = monotonic_ns() - t_start;
+
+		if (capture_error) {
+			std::rethrow_exception(capture_error);
+		}
+	}
+
+private:
+	static std::size_t checked_depth(std::size_t depth) {
+		if (depth < 2) {
+			throw std::invalid_argument("Pipeline depth must be at least 2, got " + std::to_string(depth));
+		}
+		return depth;
+	}
+
+	void wait_capture() {
+		ring.wait_until([this]() { return capture_done.load(std::memory_order_acquire); });
+	}
+
+	void capture_thread() {
+		// Parks until `run()` starts another sweep, or the scheduler goes
+		std::uint64_t done_runs = 0;
+		while (true) {
+			ring.wait_until([&]() {
+				return runs.load(std::memory_order_acquire) != done_runs || shutdown.load(std::memory_order_acquire);
+			});
+			if (shutdown.load(std::memory_order_acquire)) {
+				return;
+			}
+
+			done_runs = runs.load(std::memory_order_acquire);
+			capture_loop();
+		}
+	}
+
+	void capture_loop() {
+		try {
+			for (std::size_t step = 0; step < freqs.size(); step++) {
+				// The ring may have spare slots (it rounds up to a power of
+				// two); only `pipeline_depth` blocks are ever in flight
+				bool waited = ring.size() >= pipeline_depth;
+				ring.wait_until([this]() {
+					return ring.size() < pipeline_depth || abort.load(std::memory_order_relaxed);
+				});
+				if (abort.load(std::memory_order_relaxed)) {
+					break;
+				}
+				stats.capture_stalls += waited;
+
+				unsigned char* slot = ring.write_slot();
+
+				std::uint64_t t0 = monotonic_ns();
+				sdr.set_center_freq(freqs[step]);
+				if (settle_bytes > 0) {
+					sdr.read_bytes_view(settle_bytes);
+				}
+
+				sdr.read_bytes(std::span<unsigned char>(slot, ring.block_size()));
+				stats.capture_ns += monotonic_ns() - t0;
+
+				meta[step & (ring.capacity() - 1)] = {step, freqs[step], sdr.last_block(), {}};
+				ring.commit(ring.block_size());
+			}
+		}
+		catch (...) {
+			capture_error = std::current_exception();
+		}
+
+		capture_done.store(true, std::memory_order_release);
+		ring.wake();
+	}
+
+	SdrBackend& sdr;
+	std::vector<std::uint32_t> freqs;
+	std::size_t settle_bytes;
+	std::size_t pipeline_depth;
+
+	BlockRing ring;
+	std::vector<SweepBlock> meta; // indexed by step & (capacity-1)
+
+	std::thread capture;
+	std::atomic<std::uint64_t> runs{0}; // bumped by run() to start capture
+	std::atomic<bool> shutdown{false};
+	std::atomic<bool> abort{false};
+	std::atomic<bool> capture_done{false};
+	std::exception_ptr capture_error;
+
+	// Fields are split between the two threads; read only once capture
+	// is done
+	SweepTiming stats;
+};
+
+} // namespace rtlsdr
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef RTLSDRPP_THREADPOOL_HPP
+#define RTLSDRPP_THREADPOOL_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+
+namespace rtlsdr {
+
+// Tasks each worker's queue holds before submitters have to wait
+const std::size_t DEFAULT_POOL_QUEUE = 256;
+
+class PoolTask {
+	// Move-only `void(std::size_t worker)` callable, stored inline
+	//
+	// std::function puts anything bigger than a couple of pointers on the
+	// heap. A PoolTask holds up to CAPACITY bytes of captures in place and
+	// never allocates, so queuing one is a move into a preallocated slot.
+	// Larger callables don't compile; capture a pointer to them instead.
+	//
+public:
+	static constexpr std::size_t CAPACITY = 48;
+
+	PoolTask() = default;
+
+	template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, PoolTask>>>
+	PoolTask(F&& f) {
+		using Fn = std::decay_t<F>;
+		static_assert(sizeof(Fn) <= CAPACITY && alignof(Fn) <= alignof(std::max_align_t),
+			"Task captures too much to store inline; capture a pointer to it instead");
+		static_assert(std::is_nothrow_move_constructible_v<Fn>, "Tasks must be nothrow movable");
+
+		::new (static_cast<void*>(buf)) Fn(std::forward<F>(f));
+		call = [](void* p, std::size_t worker) { (*static_cast<Fn*>(p))(worker); };
+		relocate = [](void* dst, void* src) {
+			// Moves src into dst (if given), then destroys src
+			if (dst != nullptr) {
+				::new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+			}
+			static_cast<Fn*>(src)->~Fn();
+		};
+	}
+
+	PoolTask(PoolTask&& o) noexcept { take(o); }
+
+	PoolTask& operator=(PoolTask&& o) noexcept {
+		if (this != &o) {
+			reset();
+			take(o);
+		}
+		return *this;
+	}
+
+	PoolTask(const PoolTask&) = delete;
+	PoolTask& operator=(const PoolTask&) = delete;
+
+	~PoolTask() { reset(); }
+
+	explicit operator bool() const { return call != nullptr; }
+
+	void operator()(std::size_t worker) { call(buf, worker); }
+
+	void reset() {
+		if (relocate != nullptr) {
+			relocate(nullptr, buf);
+		}
+		call = nullptr;
+		relocate = nullptr;
+	}
+
+private:
+	void take(PoolTask& o) {
+		if (o.relocate == nullptr) {
+			return;
+		}
+
+		o.relocate(buf, o.buf);
+		call = o.call;
+		relocate = o.relocate;
+		o.call = nullptr;
+		o.relocate = nullptr;
+	}
+
+	alignas(std::max_align_t) unsigned char buf[CAPACITY];
+	void (*call)(void*, std::size_t) = nullptr;
+	void (*relocate)(void*, void*) = nullptr;
+};
+
+class ThreadPool {
+	// Fixed set of workers with per-worker queues and work stealing
+	//
+	// Tasks are called as `fn(worker)`, where `worker` is the index
+	// (0..size()-1) of the thread running them, so callers can keep one
+	// set of scratch state (FFT plans, buffers) per worker and never lock
+	// it.
+	//
+	// Each worker takes from the front of its own queue and, when that's
+	// empty, steals from the back of the others'. Tasks submitted from a
+	// worker go to that worker's queue; everything else is dealt out
+	// round robin.
+	//
+	// Queues are fixed rings of inline tasks (PoolTask), allocated here,
+	// so submitting never touches the heap. When every queue is full, an
+	// outside submitter waits for a slot and a worker runs the task itself.
+	//
+	// Arguments:
+	//	num_threads: Workers to start. With 0, `submit()` runs each task
+	//		on the calling thread as worker 0.
+	//	queue_depth: Tasks each worker's queue holds, rounded up to a
+	//		power of two
+	//
+public:
+	using Task = PoolTask;
+
+	ThreadPool(std::size_t num_threads=std::thread::hardware_concurrency(),
+		std::size_t queue_depth=DEFAULT_POOL_QUEUE) {
+
+		std::size_t cap = 1;
+		while (cap < queue_depth) {
+			cap <<= 1;
+		}
+
+		for (std::size_t i = 0; i < num_threads; i++) {
+			queues.emplace_back(std::make_unique<Queue>(cap));
+		}
+		total_slots = num_threads * cap;
+		for (std::size_t i = 0; i < num_threads; i++) {
+			threads.emplace_back([this, i]() { work(i); });
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(sleep_mtx);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (auto& t: threads) {
+			t.join();
+		}
+	}
+
+	std::size_t size() const { return threads.size(); }
+
+	std::size_t num_slots() const {
+		// Distinct `worker` values tasks can see; size per-worker state by this
+		return threads.empty() ? 1 : threads.size();
+	}
+
+	void submit(Task fn) {
+		if (threads.empty()) {
+			run(fn, 0);
+			return;
+		}
+
+		pending.fetch_add(1, std::memory_order_relaxed);
+
+		bool from_worker = (tl_pool == this);
+		std::size_t first = from_worker ? tl_worker : next.fetch_add(1, std::memory_order_relaxed) % threads.size();
+
+		while (!push(first, fn)) {
+			if (from_worker) {
+				// Waiting here could leave every worker waiting on the
+				// others; doing the task now can't
+				run(fn, tl_worker);
+				finish();
+				return;
+			}
+
+			std::unique_lock<std::mutex> lock(sleep_mtx);
+			space_waiters++;
+			space.wait(lock, [this]() { return queued < total_slots; });
+			space_waiters--;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(sleep_mtx);
+			queued++;
+		}
+		wake.notify_one();
+	}
+	void wait() {
+		// Blocks until every submitted task has finished, then rethrows
+		// the first exception any of them threw
+		{
+			std::unique_lock<std::mutex> lock(sleep_mtx);
+			done.wait(lock, [this]() { return pending.load(std::memory_order_acquire) == 0; });
+		}
+
+		std::exception_ptr e;
+		{
+			std::lock_guard<std::mutex> lock(error_mtx);
+			std::swap(e, error);
+		}
+		if (e) {
+			std::rethrow_exception(e);
+		}
+	}
+
+	template <typename Fn>
+	void parallel_for(std::size_t n, Fn fn) {
+		// Calls `fn(worker, i)` for i in [0, n) and waits for all of them
+		for (std::size_t i = 0; i < n; i++) {
+			submit([&fn, i](std::size_t w) { fn(w, i); });
+		}
+		wait();
+	}
+
+private:
+	struct Queue {
+		// Ring of task slots; the front is at `head`, the back at `tail-1`
+		Queue(std::size_t cap): slots(cap), mask(cap - 1) {}
+
+		std::mutex mtx;
+		std::vector<Task> slots;
+		std::size_t mask;
+		std::size_t head = 0, tail = 0;
+	};
+
+	bool push(std::size_t first, Task& fn) {
+		// Queues fn on the first queue from `first` on with room
+		for (std::size_t k = 0; k < queues.size(); k++) {
+			Queue& q = *queues[(first + k) % queues.size()];
+			std::lock_guard<std::mutex> lock(q.mtx);
+
+			if (q.tail - q.head <= q.mask) {
+				q.slots[q.tail++ & q.mask] = std::move(fn);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void finish() {
+		if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			std::lock_guard<std::mutex> lock(sleep_mtx);
+			done.notify_all();
+		}
+	}
+
+	void run(Task& fn, std::size_t worker) {
+		try {
+			fn(worker);
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(error_mtx);
+			if (!error) {
+				error = std::current_exception();
+			}
+		}
+	}
+
+	bool take(std::size_t self, Task& out) {
+		// Own queue first (oldest task), then steal the newest from others
+		for (std::size_t k = 0; k < queues.size(); k++) {
+			Queue& q = *queues[(self + k) % queues.size()];
+			std::lock_guard<std::mutex> lock(q.mtx);
+
+			if (q.head == q.tail) {
+				continue;
+			}
+
+			if (k == 0) {
+				out = std::move(q.slots[q.head++ & q.mask]);
+			}
+			else {
+				out = std::move(q.slots[--q.tail & q.mask]);
+			}
+			return true;
+		}
+
+		return false;
+	}
+
+	void work(std::size_t self) {
+		tl_pool = this;
+		tl_worker = self;
+
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(sleep_mtx);
+				wake.wait(lock, [this]() { return stopping || queued > 0; });
+				if (queued == 0) {
+					return; // stopping, and nothing left
+				}
+				queued--;
+			}
+
+			// A queued task is reserved for us; one of the queues has it
+			Task fn;
+			while (!take(self, fn)) {
+				std::this_thread::yield();
+			}
+
+			if (space_waiters > 0) {
+				// A submitter that registers after this check tests
+				// `queued` under the lock first, so it can't miss the slot
+				std::lock_guard<std::mutex> lock(sleep_mtx);
+				space.notify_all();
+			}
+
+			run(fn, self);
+			fn.reset();
+			finish();
+		}
+	}
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+	std::atomic<std::size_t> next{0};
+
+	std::mutex sleep_mtx;
+	std::condition_variable wake, done, space;
+	std::size_t queued = 0; // tasks in queues not yet claimed by a worker
+	std::size_t total_slots = 0;
+	std::atomic<std::size_t> space_waiters{0};
+	bool stopping = false;
+	std::atomic<std::size_t> pending{0}; // submitted but not finished
+
+	std::mutex error_mtx;
+	std::exception_ptr error;
+
+	static inline thread_local ThreadPool* tl_pool = nullptr;
+	static inline thread_local std::size_t tl_worker = 0;
+};
+
+} // namespace rtlsdr
+
+#endif
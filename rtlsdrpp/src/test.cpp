@@ -1,8 +1,8 @@
 #include <iostream>
-#include <fstream>
 #include <vector>
 
 #include "rtlsdrpp.hpp"
+#include "recorder.hpp"
 
 int main() {
 	rtlsdr::RtlSdr sdr;
@@ -11,13 +11,17 @@ int main() {
 	sdr.set_center_freq(91.5e6);
 	sdr.set_gain(0);
 
-	auto samples = sdr.read_samples(256*1024);
+	// Writes ../data.sigmf-data (raw cu8) and ../data.sigmf-meta
+	rtlsdr::IqRecorder rec("../data");
+	rec.set_from(sdr);
+	rec.set_hw("RTL-SDR");
 
+	sdr.start_stream();
+	std::size_t n = rec.record(sdr, 2*256*1024);
+	sdr.stop_stream();
+
+	rec.close();
 	sdr.close();
 
-	std::ofstream fout("../data.txt");
-	for (auto& sample: samples) {
-		fout << sample.real() << "+" << sample.imag() << "j\n";
-	}
-	fout.close();
+	std::cout << "Recorded " << n/2 << " samples\n";
 }
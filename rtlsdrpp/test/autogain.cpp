@@ -0,0 +1,90 @@
+// Level histograms against a per-byte reference, and AutoGain ranging a
+// synthetic source whose clipping point is known
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <stdexcept>
+
+#include "autogain.hpp"
+#include "sources.hpp"
+#include "check.hpp"
+
+static rtlsdr::LevelHistogram reference_histogram(std::span<const unsigned char> bytes) {
+	rtlsdr::LevelHistogram h;
+	for (unsigned char b: bytes) {
+		int m = static_cast<int>(std::floor(std::abs(b - 127.5)));
+		int k = 0;
+		while (k < 7 && m >= (1 << k)) {
+			k++;
+		}
+		h.bits[k]++;
+		h.clipped += (b == 0 || b == 255);
+		h.total++;
+	}
+	return h;
+}
+
+static void test_histogram() {
+	// Lengths straddle the SIMD step and its 255-step counter flush
+	std::mt19937 rng(4);
+	std::normal_distribution<double> level(127.5, 40);
+
+	for (std::size_t n: {0, 1, 31, 32, 33, 1000, 255*32, 255*32 + 17, 100000}) {
+		std::vector<unsigned char> bytes(n);
+		for (auto& b: bytes) {
+			b = static_cast<unsigned char>(std::clamp(std::lround(level(rng)), 0L, 255L));
+		}
+
+		auto h = rtlsdr::level_histogram(bytes);
+		auto ref = reference_histogram(bytes);
+		CHECK(h.bits == ref.bits);
+		CHECK(h.clipped == ref.clipped);
+		CHECK(h.total == n);
+	}
+
+	std::vector<unsigned char> quiet(64, 128), railed(64, 255);
+	CHECK(rtlsdr::level_histogram(quiet).peak_bits() == 0);
+	CHECK(rtlsdr::level_histogram(railed).peak_bits() == 7);
+	CHECK(rtlsdr::level_histogram(railed).clip_fraction() == 1);
+}
+
+static void test_ranging() {
+	// SyntheticSdr's gain is unity at 20 dB. A 0.1 tone reaches the rails
+	// at 40 dB, so the search must stop just below that, in a handful of
+	// probes, and only once per band
+	rtlsdr::SyntheticSdr synth({{100.1e6, 0.1}});
+	synth.set_center_freq(100e6);
+
+	rtlsdr::AutoGain agc(synth, rtlsdr::DEFAULT_AGC_BURST, rtlsdr::DEFAULT_MAX_CLIP, 10000000, 0);
+
+	int g = agc.range();
+	CHECK(g == 38 || g == 39);
+	CHECK(synth.tuner_state().gain == g);
+	CHECK(agc.probes() <= 6);
+	CHECK(agc.last_histogram().total == rtlsdr::DEFAULT_AGC_BURST);
+
+	// Same band: cached, no probes
+	std::size_t probes = agc.probes();
+	CHECK(agc.range(105e6) == g);
+	CHECK(agc.probes() == probes);
+	CHECK(agc.cached_bands() == 1);
+
+	// The synthetic source doesn't band-limit, so a strong tone added
+	// anywhere lowers the gain a new band is ranged to
+	synth.add_tone({130.1e6, 0.3});
+	CHECK(agc.range(130e6) < g);
+	CHECK(agc.probes() > probes);
+	CHECK(agc.cached_bands() == 2);
+
+	agc.forget();
+	CHECK(agc.cached_bands() == 0);
+}
+
+int main() {
+	SKIP_WITHOUT_HOST_SIMD();
+
+	test_histogram();
+	test_ranging();
+	return report();
+}
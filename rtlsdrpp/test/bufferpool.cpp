@@ -0,0 +1,69 @@
+// BufferPool: buffers are recycled rather than reallocated, come back from
+// any thread, and are aligned for the SIMD kernels
+
+#include <vector>
+#include <thread>
+#include <cstdint>
+
+#include "bufferpool.hpp"
+#include "check.hpp"
+
+static void test_recycle() {
+	rtlsdr::BufferPool<float> pool;
+	pool.reserve(2, 1000);
+	CHECK(pool.available() == 2);
+
+	float* first;
+	{
+		auto a = pool.acquire(1000);
+		CHECK(a.size() == 1000 && a.span().size() == 1000);
+		CHECK(reinterpret_cast<std::uintptr_t>(a.data()) % 64 == 0);
+		CHECK(pool.available() == 1);
+		first = a.data();
+		a[999] = 1;
+	}
+	CHECK(pool.available() == 2);
+
+	// The buffer just returned is the next one out, at any smaller size
+	auto b = pool.acquire(10);
+	CHECK(b.data() == first && b.size() == 10);
+
+	// Moving hands over ownership; release is idempotent
+	auto c = std::move(b);
+	CHECK(c.data() == first);
+	c.release();
+	c.release();
+	CHECK(pool.available() == 2);
+
+	// Asking for more than a pooled buffer holds grows it
+	auto d = pool.acquire(5000);
+	CHECK(d.size() == 5000);
+}
+
+static void test_cross_thread() {
+	// Taken on one thread, returned on another, as the server's step
+	// blocks are
+	rtlsdr::BufferPool<float> pool;
+	pool.reserve(4, 256);
+
+	for (int round = 0; round < 100; round++) {
+		std::vector<rtlsdr::BufferPool<float>::Buffer> held;
+		for (int i = 0; i < 4; i++) {
+			held.push_back(pool.acquire(256));
+		}
+
+		std::thread t([&held]() {
+			for (auto& b: held) {
+				b.release();
+			}
+		});
+		t.join();
+	}
+	CHECK(pool.available() == 4);
+}
+
+int main() {
+	test_recycle();
+	test_cross_thread();
+	return report();
+}
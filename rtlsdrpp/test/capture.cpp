@@ -0,0 +1,143 @@
+// CaptureReader: format detection, conversion of each format, chunking and
+// reads clipped at the end of the file
+
+#include <vector>
+#include <string>
+#include <complex>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <cstdint>
+#include <cmath>
+
+#include "capture.hpp"
+#include "check.hpp"
+
+using cf = std::complex<float>;
+
+static std::string temp_path(const std::string& name) {
+	return (std::filesystem::temp_directory_path() / name).string();
+}
+
+static void write_file(const std::string& path, const void* data, std::size_t len) {
+	std::ofstream out(path, std::ios::binary);
+	out.write(static_cast<const char*>(data), len);
+}
+
+static void test_guess_format() {
+	std::string base = temp_path("rtlsdrpp_test_guess");
+	std::ofstream(base + ".sigmf-meta") << "{\"global\": {\"core:datatype\": \"cf32_le\"}}";
+
+	CHECK(rtlsdr::guess_format(base + ".sigmf-data") == rtlsdr::SampleFormat::CF32);
+	CHECK(rtlsdr::guess_format("x.cs8") == rtlsdr::SampleFormat::CS8);
+	CHECK(rtlsdr::guess_format("x.cfile") == rtlsdr::SampleFormat::CF32);
+	CHECK(rtlsdr::guess_format("x.bin") == rtlsdr::SampleFormat::CU8);
+
+	std::ofstream(base + ".sigmf-meta") << "{\"global\": {\"core:datatype\": \"ri16_le\"}}";
+	bool threw = false;
+	try {
+		rtlsdr::guess_format(base + ".sigmf-data");
+	}
+	catch (const std::runtime_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+
+	std::filesystem::remove(base + ".sigmf-meta");
+}
+
+static void test_formats() {
+	// The same 1000 samples stored as cu8, cs8 and cf32 read back the same
+	const std::size_t n = 1000;
+	std::vector<unsigned char> u8(2*n);
+	std::vector<std::int8_t> s8(2*n);
+	std::vector<float> f32(2*n);
+	for (std::size_t k = 0; k < 2*n; k++) {
+		int v = static_cast<int>((k * 37) % 255) - 127;
+		s8[k] = static_cast<std::int8_t>(v);
+		u8[k] = static_cast<unsigned char>(v + 128);
+		f32[k] = v / 128.0f;
+	}
+
+	std::string p_u8 = temp_path("rtlsdrpp_test.cu8");
+	std::string p_s8 = temp_path("rtlsdrpp_test.cs8");
+	std::string p_f32 = temp_path("rtlsdrpp_test.cf32");
+	write_file(p_u8, u8.data(), u8.size());
+	write_file(p_s8, s8.data(), s8.size());
+	write_file(p_f32, f32.data(), f32.size()*sizeof(float));
+
+	{
+		rtlsdr::CaptureReader cu8(p_u8, 300), cs8(p_s8, 300), cf32(p_f32, 300);
+		CHECK(cu8.format() == rtlsdr::SampleFormat::CU8);
+		CHECK(cs8.format() == rtlsdr::SampleFormat::CS8);
+		CHECK(cf32.format() == rtlsdr::SampleFormat::CF32);
+		CHECK(cu8.num_samples() == n && cs8.num_samples() == n && cf32.num_samples() == n);
+		CHECK(cu8.num_chunks() == 4);
+
+		// cu8 is offset by 127.5 rather than 128, so it differs by 0.5/127.5
+		// scaled; cs8 and cf32 agree exactly
+		std::vector<cf> a(n), b(n), c(n);
+		CHECK(cu8.read(0, std::span(a)) == n);
+		CHECK(cs8.read(0, std::span(b)) == n);
+		CHECK(cf32.read(0, std::span(c)) == n);
+
+		double worst_u8 = 0, worst_s8 = 0;
+		for (std::size_t i = 0; i < n; i++) {
+			worst_u8 = std::max(worst_u8, double(std::abs(a[i] - c[i])));
+			worst_s8 = std::max(worst_s8, double(std::abs(b[i] - c[i])));
+		}
+		CHECK(worst_u8 < 0.02);
+		CHECK(worst_s8 == 0);
+
+		// Chunks tile the capture, the last one short; cf32 chunks point
+		// straight into the mapping
+		std::size_t total = 0;
+		bool same = true;
+		cs8.for_each_chunk([&](std::size_t i, std::span<const cf> s) {
+			for (std::size_t k = 0; k < s.size(); k++) {
+				same = same && s[k] == b[i*300 + k];
+			}
+			total += s.size();
+		});
+		CHECK(same && total == n);
+		CHECK(cs8.chunk(3).size() == 100);
+		CHECK(reinterpret_cast<const unsigned char*>(cf32.chunk(1).data()) == cf32.raw().data() + 300*8);
+
+		// Reads are clipped at the end, and past it return nothing
+		std::vector<std::complex<double>> tail(50);
+		CHECK(cu8.read(980, std::span(tail)) == 20);
+		CHECK(std::abs(tail[0] - std::complex<double>(a[980])) < 1e-6);
+		CHECK(cu8.read(n, std::span(tail)) == 0);
+
+		bool threw = false;
+		try {
+			cu8.chunk(4);
+		}
+		catch (const std::out_of_range&) {
+			threw = true;
+		}
+		CHECK(threw);
+	}
+
+	std::filesystem::remove(p_u8);
+	std::filesystem::remove(p_s8);
+	std::filesystem::remove(p_f32);
+}
+
+static void test_open_errors() {
+	bool threw = false;
+	try {
+		rtlsdr::CaptureReader cap(temp_path("rtlsdrpp_test_missing.cu8"));
+	}
+	catch (const std::runtime_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+int main() {
+	test_guess_format();
+	test_formats();
+	test_open_errors();
+	return report();
+}
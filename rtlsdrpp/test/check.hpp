@@ -0,0 +1,48 @@
+#ifndef RTLSDRPP_TEST_CHECK_HPP
+#define RTLSDRPP_TEST_CHECK_HPP
+
+// Minimal checking for the test binaries under test/. CHECK() reports and
+// counts failures; each binary's main() ends with `return report();`.
+
+#include <iostream>
+
+inline int check_failures = 0;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+		check_failures++; \
+	} \
+} while (0)
+
+// Return code CTest counts as a skip (SKIP_RETURN_CODE in CMakeLists.txt)
+const int SKIPPED = 77;
+
+inline bool host_runs_build_simd() {
+	// The *_avx2 test builds target AVX2/FMA whatever machine they're
+	// built on; they can only run where the CPU has both
+#if defined(__AVX2__) && (defined(__x86_64__) || defined(__i386__))
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+	return true;
+#endif
+}
+
+#define SKIP_WITHOUT_HOST_SIMD() do { \
+	if (!host_runs_build_simd()) { \
+		std::cout << "CPU lacks the instructions this build targets, skipped\n"; \
+		return SKIPPED; \
+	} \
+} while (0)
+
+inline int report() {
+	if (check_failures) {
+		std::cerr << check_failures << " check(s) failed\n";
+		return 1;
+	}
+
+	std::cout << "All checks passed\n";
+	return 0;
+}
+
+#endif
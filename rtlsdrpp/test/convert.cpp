@@ -0,0 +1,100 @@
+// convert_samples against the reference formula for every supported
+// output type, including the SIMD float kernel and its scalar tail
+
+#include <vector>
+#include <complex>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include "convert.hpp"
+#include "check.hpp"
+
+template <typename T>
+static double worst_error(const std::vector<unsigned char>& bytes) {
+	// Largest deviation from raw/127.5 - 1, in units of the scalar type
+	using scalar = typename rtlsdr::sample_traits<T>::scalar;
+	constexpr std::size_t comps = rtlsdr::is_complex<T>::value ? 2 : 1;
+
+	std::vector<T> out(bytes.size() / comps);
+	rtlsdr::convert_samples<T>(bytes, std::span(out));
+
+	const scalar* v = reinterpret_cast<const scalar*>(out.data());
+	double worst = 0;
+	for (std::size_t i = 0; i < out.size() * comps; i++) {
+		double ref = bytes[i]/(255.0/2.0) - 1;
+		if constexpr (std::is_integral_v<scalar>) {
+			ref = std::lround(ref * 32767);
+		}
+		worst = std::max(worst, std::abs(double(v[i]) - ref));
+	}
+	return worst;
+}
+
+static void test_types() {
+	std::mt19937 rng(3);
+	std::uniform_int_distribution<int> u(0, 255);
+
+	// Lengths around the 16-byte SIMD step, so the tail path runs too
+	for (std::size_t n: {1, 2, 15, 16, 17, 33, 100, 4099}) {
+		std::vector<unsigned char> bytes(n);
+		for (auto& b: bytes) {
+			b = static_cast<unsigned char>(u(rng));
+		}
+		bytes[0] = 0;
+		bytes[n-1] = 255;
+
+		CHECK(worst_error<float>(bytes) < 1e-6);
+		CHECK(worst_error<double>(bytes) < 1e-12);
+		CHECK(worst_error<std::int16_t>(bytes) == 0);
+		CHECK(worst_error<std::complex<float>>(bytes) < 1e-6);
+		CHECK(worst_error<std::complex<double>>(bytes) < 1e-12);
+	}
+}
+
+static void test_simd_kernel() {
+	// The float kernel handles every whole 16-byte group when it's
+	// compiled in (AVX2 or NEON), and nothing otherwise
+	std::vector<unsigned char> bytes(100);
+	std::vector<float> out(100);
+	for (std::size_t i = 0; i < bytes.size(); i++) {
+		bytes[i] = static_cast<unsigned char>(i * 37);
+	}
+
+	std::size_t done = rtlsdr::detail::convert_f32_simd(bytes.data(), out.data(), bytes.size());
+#if defined(__AVX2__) || defined(__ARM_NEON)
+	CHECK(done == 96);
+#else
+	CHECK(done == 0);
+#endif
+
+	double worst = 0;
+	for (std::size_t i = 0; i < done; i++) {
+		worst = std::max(worst, std::abs(out[i] - (bytes[i]/(255.0/2.0) - 1)));
+	}
+	CHECK(worst < 1e-6);
+}
+
+static void test_short_output() {
+	std::vector<unsigned char> bytes(10);
+	std::vector<std::complex<float>> out(4);
+
+	bool threw = false;
+	try {
+		rtlsdr::convert_samples<std::complex<float>>(bytes, std::span(out));
+	}
+	catch (const std::length_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+int main() {
+	SKIP_WITHOUT_HOST_SIMD();
+
+	test_types();
+	test_simd_kernel();
+	test_short_output();
+	return report();
+}
@@ -0,0 +1,148 @@
+// Ddc: NCO accuracy over a long run, what the decimating filter passes and
+// rejects, and that block boundaries don't change the output
+
+#include <vector>
+#include <complex>
+#include <numbers>
+#include <stdexcept>
+#include <cmath>
+
+#include "ddc.hpp"
+#include "check.hpp"
+
+using cf = std::complex<float>;
+
+static std::vector<cf> tone(std::size_t n, double f, double fs, double a) {
+	std::vector<cf> x(n);
+	for (std::size_t i = 0; i < n; i++) {
+		x[i] = std::polar(a, 2*std::numbers::pi * f * double(i) / fs);
+	}
+	return x;
+}
+
+static void test_mixer() {
+	// With one tap and no decimation the Ddc is just the NCO, which must
+	// stay on frequency and at unit amplitude for a million samples
+	const double fs = 2.4e6, f = 123456.7;
+	const std::size_t n = 1000000;
+	CHECK(rtlsdr::lowpass_taps<float>(1, 0.5).size() == 1);
+
+	rtlsdr::Ddc<float> ddc(fs, f, 1, 1);
+	std::vector<cf> x(n, cf(1, 0)), y(n);
+	CHECK(ddc.process(std::span<const cf>(x), std::span(y)) == n);
+
+	double worst = 0;
+	for (std::size_t i = 0; i < n; i++) {
+		std::complex<double> ref = std::polar(1.0, -2*std::numbers::pi * std::fmod(f * i / fs, 1.0));
+		worst = std::max(worst, std::abs(std::complex<double>(y[i]) - ref));
+	}
+	CHECK(worst < 1e-5);
+}
+
+static double settled_mean_power(const std::vector<cf>& y, std::size_t skip) {
+	double p = 0;
+	for (std::size_t i = skip; i < y.size(); i++) {
+		p += std::norm(y[i]);
+	}
+	return p / (y.size() - skip);
+}
+
+static void test_passband() {
+	// A tone at the NCO frequency comes out at DC with unity gain (half
+	// amplitude for a real input, whose other half is at -2f and filtered
+	// away); one well outside the output band is suppressed
+	const double fs = 2.4e6;
+	const std::size_t decim = 16, n = 160000;
+
+	{
+		rtlsdr::Ddc<float> ddc(fs, 200e3, decim);
+		CHECK(ddc.output_rate() == fs / decim);
+
+		auto x = tone(n, 200e3, fs, 0.5);
+		std::vector<cf> y(ddc.max_output(n));
+		std::size_t m = ddc.process(std::span<const cf>(x), std::span(y));
+		CHECK(m == n / decim);
+		y.resize(m);
+		CHECK(std::abs(settled_mean_power(y, 100) - 0.25) < 0.0025);
+	}
+
+	{
+		rtlsdr::Ddc<float> ddc(fs, 200e3, decim);
+		std::vector<float> x(n);
+		for (std::size_t i = 0; i < n; i++) {
+			x[i] = 0.5 * std::cos(2*std::numbers::pi * 200e3 * i / fs);
+		}
+		std::vector<cf> y(ddc.max_output(n));
+		y.resize(ddc.process(std::span<const float>(x), std::span(y)));
+		CHECK(std::abs(settled_mean_power(y, 100) - 0.0625) < 0.001);
+	}
+
+	{
+		// Output Nyquist is 75 kHz; 300 kHz off is deep in the stopband
+		rtlsdr::Ddc<float> ddc(fs, 200e3, decim);
+		auto x = tone(n, 500e3, fs, 0.5);
+		std::vector<cf> y(ddc.max_output(n));
+		y.resize(ddc.process(std::span<const cf>(x), std::span(y)));
+		CHECK(settled_mean_power(y, 100) < 0.25e-6);
+	}
+}
+
+static void test_block_split() {
+	// Feeding a stream in odd-sized blocks, some shorter than the
+	// decimation factor and the NCO group, gives the same output as one call
+	const double fs = 1e6;
+	const std::size_t decim = 5, n = 20000;
+	auto x = tone(n, 37e3, fs, 0.7);
+
+	rtlsdr::Ddc<float> whole(fs, 30e3, decim), split(fs, 30e3, decim);
+
+	std::vector<cf> a(whole.max_output(n));
+	a.resize(whole.process(std::span<const cf>(x), std::span(a)));
+
+	std::vector<cf> b, part;
+	for (std::size_t i = 0, step = 1; i < n; i += step, step = step*7 % 613 + 1) {
+		std::size_t len = std::min(step, n - i);
+		part.resize(split.max_output(len));
+		std::size_t m = split.process(std::span<const cf>(x).subspan(i, len), std::span(part));
+		b.insert(std::end(b), std::begin(part), std::begin(part) + m);
+	}
+
+	CHECK(a.size() == n / decim);
+	CHECK(b.size() == a.size());
+
+	double worst = 0;
+	for (std::size_t i = 0; i < std::min(a.size(), b.size()); i++) {
+		worst = std::max(worst, double(std::abs(a[i] - b[i])));
+	}
+	CHECK(worst < 1e-5);
+}
+
+static void test_errors() {
+	bool threw = false;
+	try {
+		rtlsdr::Ddc<float> ddc(1e6, 0, 0);
+	}
+	catch (const std::invalid_argument&) {
+		threw = true;
+	}
+	CHECK(threw);
+
+	rtlsdr::Ddc<float> ddc(1e6, 0, 4);
+	std::vector<cf> x(100), y(24);
+	threw = false;
+	try {
+		ddc.process(std::span<const cf>(x), std::span(y));
+	}
+	catch (const std::length_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+int main() {
+	test_mixer();
+	test_passband();
+	test_block_split();
+	test_errors();
+	return report();
+}
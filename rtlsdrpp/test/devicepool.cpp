@@ -0,0 +1,126 @@
+// DevicePool: a sweep split across several synthetic devices visits every
+// step once on the right device, reuses its threads, allocates nothing in
+// steady state, and reports a device's error
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <cstdlib>
+#include <new>
+
+#include "devicepool.hpp"
+#include "check.hpp"
+
+static std::atomic<bool> counting{false};
+static std::atomic<std::size_t> allocations{0};
+
+void* operator new(std::size_t n) {
+	if (counting.load(std::memory_order_relaxed)) {
+		allocations.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (void* p = std::malloc(n ? n : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+static rtlsdr::DevicePool make_pool(std::size_t n) {
+	std::vector<std::unique_ptr<rtlsdr::SdrBackend>> backends;
+	for (std::size_t i = 0; i < n; i++) {
+		backends.emplace_back(std::make_unique<rtlsdr::SyntheticSdr>());
+	}
+	return rtlsdr::DevicePool(std::move(backends));
+}
+
+static void test_sweep() {
+	auto sdrs = make_pool(3);
+	auto plan = rtlsdr::linear_sweep(1e6, 2e6, 20);
+
+	std::mutex mtx;
+	std::vector<int> visits(plan.size());
+	std::map<std::size_t, std::thread::id> thread_of;
+	bool right_device = true, right_freq = true, same_threads = true;
+
+	for (int round = 0; round < 2; round++) {
+		sdrs.sweep(plan, 4096, [&](std::size_t dev, const rtlsdr::SweepBlock& blk) {
+			std::lock_guard<std::mutex> lock(mtx);
+			visits[blk.step]++;
+
+			auto [first, last] = sdrs.slice(dev, plan.size());
+			right_device = right_device && blk.step >= first && blk.step < last;
+			right_freq = right_freq && blk.freq == plan[blk.step] && blk.info.tuner.center_freq == blk.freq;
+			right_freq = right_freq && blk.bytes.size() == 4096;
+
+			auto [it, added] = thread_of.emplace(dev, std::this_thread::get_id());
+			same_threads = same_threads && it->second == std::this_thread::get_id();
+		}, 1024);
+	}
+
+	bool twice = true;
+	for (int v: visits) {
+		twice = twice && v == 2;
+	}
+	CHECK(twice);
+	CHECK(right_device);
+	CHECK(right_freq);
+	CHECK(same_threads && thread_of.size() == 3);
+	CHECK(thread_of[0] != thread_of[1]);
+
+	// The pool can still be moved once its threads are running
+	rtlsdr::DevicePool moved(std::move(sdrs));
+	std::atomic<int> steps{0};
+	moved.sweep(plan, 4096, [&](std::size_t, const rtlsdr::SweepBlock&) { steps++; }, 1024);
+	CHECK(steps == int(plan.size()));
+}
+
+static void test_no_allocation() {
+	auto sdrs = make_pool(2);
+	auto plan = rtlsdr::linear_sweep(1e6, 2e6, 40);
+	std::atomic<std::size_t> steps{0};
+	auto on_step = [&steps](std::size_t, const rtlsdr::SweepBlock&) { steps++; };
+
+	sdrs.sweep(plan, 8192, on_step);
+	counting = true;
+	sdrs.sweep(plan, 8192, on_step);
+	counting = false;
+
+	CHECK(steps == 2*plan.size());
+	CHECK(allocations == 0);
+}
+
+static void test_error() {
+	auto sdrs = make_pool(2);
+	auto plan = rtlsdr::linear_sweep(1e6, 2e6, 10);
+
+	bool threw = false;
+	try {
+		sdrs.sweep(plan, 1024, [](std::size_t, const rtlsdr::SweepBlock& blk) {
+			if (blk.step == 8) {
+				throw std::runtime_error("step failed");
+			}
+		}, 0);
+	}
+	catch (const std::runtime_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+
+	// Both devices are usable again afterwards
+	std::atomic<int> steps{0};
+	sdrs.sweep(plan, 1024, [&](std::size_t, const rtlsdr::SweepBlock&) { steps++; }, 0);
+	CHECK(steps == int(plan.size()));
+}
+
+int main() {
+	test_sweep();
+	test_no_allocation();
+	test_error();
+	return report();
+}
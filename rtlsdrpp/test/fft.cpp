@@ -0,0 +1,118 @@
+// FftPlan and RealFft against a direct DFT, through both the generic path
+// and the fixed-size kernels, plus the aligned buffers they live in
+
+#include <vector>
+#include <complex>
+#include <random>
+#include <numbers>
+#include <stdexcept>
+#include <cstdint>
+#include <cmath>
+
+#include "fft.hpp"
+#include "check.hpp"
+
+template <typename In>
+static std::complex<double> dft_bin(const std::vector<In>& x, std::size_t k) {
+	std::size_t n = x.size();
+	std::complex<double> acc = 0;
+	for (std::size_t t = 0; t < n; t++) {
+		acc += std::complex<double>(x[t]) * std::polar(1.0, -2*std::numbers::pi * double((k*t) % n) / n);
+	}
+	return acc;
+}
+
+static void test_real_fft() {
+	// 16 takes the generic path, 256 and 4096 their own kernels
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> u(-1, 1);
+
+	for (std::size_t n: {2, 16, 256, 4096}) {
+		std::vector<float> x(n);
+		for (auto& v: x) {
+			v = u(rng);
+		}
+
+		rtlsdr::RealFft<float> fft(n);
+		std::vector<std::complex<float>> X(fft.bins());
+		CHECK(fft.forward(std::span<const float>(x), std::span(X)).size() == n/2 + 1);
+
+		double worst = 0;
+		for (std::size_t k = 0; k < fft.bins(); k++) {
+			worst = std::max(worst, std::abs(std::complex<double>(X[k]) - dft_bin(x, k)));
+		}
+
+		// Float FFT error grows like sqrt(n) log n relative to |x|
+		CHECK(worst < 1e-5 * n);
+	}
+}
+
+static void test_complex_plan() {
+	// In place and out of place agree with each other and with the DFT
+	std::mt19937 rng(2);
+	std::uniform_real_distribution<double> u(-1, 1);
+
+	for (std::size_t n: {1, 8, 1024}) {
+		std::vector<std::complex<double>> x(n), out(n);
+		for (auto& v: x) {
+			v = {u(rng), u(rng)};
+		}
+
+		rtlsdr::FftPlan<double> plan(n);
+		plan.forward(x.data(), out.data());
+
+		auto inplace = x;
+		plan.forward(inplace.data());
+
+		double worst = 0;
+		bool same = true;
+		for (std::size_t k = 0; k < n; k++) {
+			worst = std::max(worst, std::abs(out[k] - dft_bin(x, k)));
+			same = same && out[k] == inplace[k];
+		}
+		CHECK(worst < 1e-10 * n);
+		CHECK(same);
+	}
+}
+
+static void test_errors() {
+	for (std::size_t n: {0, 3, 1000}) {
+		bool threw = false;
+		try {
+			rtlsdr::FftPlan<float> plan(n);
+		}
+		catch (const std::invalid_argument&) {
+			threw = true;
+		}
+		CHECK(threw);
+	}
+
+	rtlsdr::RealFft<float> fft(64);
+	std::vector<float> x(63);
+	std::vector<std::complex<float>> X(33);
+	bool threw = false;
+	try {
+		fft.forward(std::span<const float>(x), std::span(X));
+	}
+	catch (const std::length_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+static void test_alignment() {
+	rtlsdr::aligned_vector<float> a(3);
+	rtlsdr::page_aligned_vector<unsigned char> p(5);
+	CHECK(reinterpret_cast<std::uintptr_t>(a.data()) % 64 == 0);
+	CHECK(reinterpret_cast<std::uintptr_t>(p.data()) % rtlsdr::PAGE_ALIGN == 0);
+}
+
+int main() {
+	SKIP_WITHOUT_HOST_SIMD();
+
+	test_real_fft();
+	test_complex_plan();
+	test_errors();
+	test_alignment();
+	return report();
+}
@@ -0,0 +1,149 @@
+// GoertzelBank and estimate_line_rate: a tone reads A^2/4 at its own
+// frequency however the stream is split, a dropped window leaves the
+// finished ones alone, and a display's line rate is measured from the
+// spacing of its harmonics in a PSD
+
+#include <vector>
+#include <span>
+#include <random>
+#include <numbers>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include "goertzel.hpp"
+#include "psd.hpp"
+#include "check.hpp"
+
+static std::vector<float> tone(std::size_t n, double f, double fs, double amp) {
+	std::vector<float> x(n);
+	for (std::size_t i = 0; i < x.size(); i++) {
+		x[i] = amp * std::cos(2*std::numbers::pi * f * i / fs);
+	}
+	return x;
+}
+
+static void test_bank() {
+	// A tone of amplitude A reads A^2/4 at its own frequency and nothing
+	// at an unrelated one, however the stream is split into blocks
+	const double fs = 1e6, f0 = 123400;
+	const double freqs[] = {f0, 200000};
+	rtlsdr::GoertzelBank bank(freqs, fs, 10000);
+	CHECK(bank.size() == 2 && bank.resolution() == 100);
+
+	auto x = tone(40000, f0, fs, 0.5);
+
+	std::size_t made = 0;
+	for (std::size_t i = 0, step = 1; i < x.size(); i += step, step = step*3 % 4099 + 1) {
+		made += bank.push(std::span<const float>(x).subspan(i, std::min(step, x.size() - i)));
+	}
+	CHECK(made == 4 && bank.windows() == 4);
+
+	float p[2];
+	bank.powers(p);
+	CHECK(std::abs(p[0] - 0.0625) < 1e-4);
+	CHECK(p[1] < 1e-6);
+
+	// Half a window of something else, dropped, changes nothing
+	auto other = tone(5000, 200000, fs, 1);
+	bank.push(other);
+	bank.drop_window();
+	bank.push(x);
+	CHECK(bank.windows() == 8);
+
+	bank.powers(p);
+	CHECK(std::abs(p[0] - 0.0625) < 1e-4);
+	CHECK(p[1] < 1e-6);
+
+	bool threw = false;
+	try {
+		const double above[] = {fs};
+		bank.set_freqs(above);
+	}
+	catch (const std::invalid_argument&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+static void test_line_rate() {
+	// A display running 0.3% slow: its line harmonics from 500 kHz up,
+	// each with a random phase and level, in noise, as direct sampling at
+	// 500 kHz sees them, plus one strong carrier between two of them.
+	// Targets taken from the measured rate read the harmonics at full
+	// power; nominal ones miss the upper harmonics entirely.
+	const double fs = 2.4e6, fc = 500e3;
+	rtlsdr::DisplayTiming timing{65e6, 1344, 806};
+	double nominal = timing.h_freq(), fh = nominal * 0.997;
+
+	const std::size_t nfft = 65536;
+	rtlsdr::WelchPsd<float> welch(nfft, 4);
+
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<double> phase(0, 2*std::numbers::pi), level(0.02, 0.05);
+	std::normal_distribution<double> noise(0, 0.1);
+
+	std::vector<double> amp;
+	std::vector<float> x(welch.block_size() + 240000);
+	for (long k = std::ceil(fc / fh); k*fh < fc + fs/2; k++) {
+		double f = k*fh - fc, a = level(rng), ph = phase(rng);
+		amp.push_back(a);
+		for (std::size_t i = 0; i < x.size(); i++) {
+			x[i] += a * std::cos(2*std::numbers::pi * f * i / fs + ph);
+		}
+	}
+	auto carrier = tone(x.size(), 10.5 * fh - fc, fs, 0.5);
+	for (std::size_t i = 0; i < x.size(); i++) {
+		x[i] += carrier[i] + noise(rng);
+	}
+
+	std::vector<float> psd(welch.bins());
+	welch.accumulate(x, psd);
+
+	double est = rtlsdr::estimate_line_rate(psd, fs/nfft, nominal, fc);
+	CHECK(std::abs(est - fh) < 0.2);
+
+	// Offsets from fc of every harmonic in the band, at a given line rate
+	auto targets = [&](double rate) {
+		std::vector<double> f;
+		for (long k = std::ceil(fc / fh); k*fh < fc + fs/2; k++) {
+			f.push_back(k*rate - fc);
+		}
+		return f;
+	};
+
+	auto mean_ratio = [&](double rate) {
+		// Measured power over the expected a^2/4, averaged
+		auto f = targets(rate);
+		rtlsdr::GoertzelBank bank(f, fs, 120000);
+		bank.push(std::span<const float>(x).last(240000));
+
+		std::vector<float> p(f.size());
+		bank.powers(p);
+
+		double r = 0;
+		for (std::size_t k = 0; k < p.size(); k++) {
+			r += p[k] / (amp[k]*amp[k]/4);
+		}
+		return r / p.size();
+	};
+	CHECK(mean_ratio(est) > 0.9);
+	CHECK(mean_ratio(nominal) < 0.2);
+
+	bool threw = false;
+	try {
+		rtlsdr::estimate_line_rate(std::span<const float>(psd).first(100), fs/nfft, nominal, fc);
+	}
+	catch (const std::length_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+int main() {
+	SKIP_WITHOUT_HOST_SIMD();
+
+	test_bank();
+	test_line_rate();
+	return report();
+}
@@ -0,0 +1,100 @@
+// Panorama: each step lands on the grid at its tune frequency, overlaps
+// average, holds track across sweeps, and features downsample evenly
+
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cmath>
+
+#include "panorama.hpp"
+#include "check.hpp"
+
+static void test_placement() {
+	// Three 100 bin steps of 1 kHz, 50 kHz apart, 10 bins trimmed per edge.
+	// Every bin holds its own absolute frequency, so wherever steps overlap
+	// the mean must still be the grid bin's frequency.
+	const double bin_hz = 1000;
+	const std::size_t bins = 100;
+	rtlsdr::Panorama pano(bin_hz, bins, 0, 0.1);
+
+	std::vector<std::uint32_t> plan = {1000000, 1050000, 1100000};
+	pano.set_plan(plan);
+	CHECK(pano.steps() == 3);
+	CHECK(pano.size() == 100 + 80);
+	CHECK(pano.freq(0) == 1010000);
+
+	std::vector<float> spectra(plan.size() * bins);
+	for (std::size_t s = 0; s < plan.size(); s++) {
+		for (std::size_t k = 0; k < bins; k++) {
+			spectra[s*bins + k] = (plan[s] + k*bin_hz) / 1e6;
+		}
+	}
+	pano.stitch(spectra);
+
+	double worst = 0;
+	for (std::size_t g = 0; g < pano.size(); g++) {
+		worst = std::max(worst, std::abs(pano.spectrum()[g] - pano.freq(g)/1e6));
+	}
+	CHECK(worst < 1e-6);
+
+	// A tone seen by the middle step alone is halved by the first step,
+	// which overlaps it with nothing there
+	std::fill(std::begin(spectra), std::end(spectra), 0);
+	spectra[1*bins + 20] = 2;
+	pano.stitch(spectra);
+	std::size_t g = std::lround((plan[1] + 20*bin_hz - pano.freq(0)) / bin_hz);
+	CHECK(pano.spectrum()[g] == 1);
+	CHECK(std::abs(pano.max_hold()[g] - pano.freq(g)/1e6) < 1e-6); // from the first sweep
+	CHECK(pano.min_hold()[g + 1] == 0);
+
+	pano.reset_holds();
+	CHECK(std::isinf(pano.max_hold()[0]) && pano.max_hold()[0] < 0);
+
+	bool threw = false;
+	try {
+		pano.stitch(std::span<const float>(spectra).first(bins));
+	}
+	catch (const std::length_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+static void test_downsample() {
+	const float in[] = {1, 2, 3, 4, 5, 6};
+
+	float half[3];
+	rtlsdr::Panorama::downsample(in, half);
+	CHECK(half[0] == 1.5f && half[1] == 3.5f && half[2] == 5.5f);
+
+	// Wider than the input repeats bins
+	float wide[12];
+	rtlsdr::Panorama::downsample(in, wide);
+	CHECK(wide[0] == 1 && wide[1] == 1 && wide[11] == 6);
+
+	float same[6];
+	rtlsdr::Panorama::downsample(in, same);
+	CHECK(std::equal(std::begin(in), std::end(in), same));
+}
+
+static void test_bad_args() {
+	for (double trim: {-0.1, 0.5}) {
+		bool threw = false;
+		try {
+			rtlsdr::Panorama(1000, 100, 0, trim);
+		}
+		catch (const std::invalid_argument&) {
+			threw = true;
+		}
+		CHECK(threw);
+	}
+}
+
+int main() {
+	test_placement();
+	test_downsample();
+	test_bad_args();
+	return report();
+}
@@ -0,0 +1,129 @@
+// WelchPsd: white noise reads as its variance per bin whatever the window,
+// averaging shrinks the scatter, and tones land in the right bin
+
+#include <vector>
+#include <random>
+#include <numbers>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include "psd.hpp"
+#include "check.hpp"
+
+static std::vector<float> noise(std::size_t n, double sigma, unsigned seed) {
+	std::mt19937 rng(seed);
+	std::normal_distribution<float> g(0, sigma);
+	std::vector<float> x(n);
+	for (auto& v: x) {
+		v = g(rng);
+	}
+	return x;
+}
+
+static void mean_and_spread(const std::vector<float>& psd, double* mean, double* rel_std) {
+	// Over all bins but DC
+	double s = 0, s2 = 0;
+	for (std::size_t k = 1; k < psd.size(); k++) {
+		s += psd[k];
+		s2 += double(psd[k]) * psd[k];
+	}
+	std::size_t n = psd.size() - 1;
+	*mean = s / n;
+	*rel_std = std::sqrt(s2/n - *mean * *mean) / *mean;
+}
+
+static void test_noise_level() {
+	// power_scale normalization: every window reads sigma^2 per bin
+	const std::size_t nfft = 1024;
+	const double sigma = 0.1;
+
+	for (auto type: {rtlsdr::WindowType::Rectangular, rtlsdr::WindowType::Hann,
+		rtlsdr::WindowType::BlackmanHarris, rtlsdr::WindowType::FlatTop}) {
+
+		rtlsdr::WelchPsd<float> psd(nfft, 32, 0.5, {type});
+		auto x = noise(psd.block_size(), sigma, 5);
+		std::vector<float> p(psd.bins(), 0);
+		psd.accumulate(x, std::span(p));
+
+		double mean, spread;
+		mean_and_spread(p, &mean, &spread);
+		CHECK(std::abs(mean / (sigma*sigma) - 1) < 0.03);
+	}
+}
+
+static void test_averaging() {
+	// One periodogram scatters by ~100% per bin; 15 half-overlapped Hann
+	// segments by well under half that
+	const std::size_t nfft = 512;
+
+	rtlsdr::WelchPsd<float> one(nfft, 1, 0.5), many(nfft, 15, 0.5);
+	CHECK(many.hop() == 256);
+	CHECK(many.block_size() == 512 + 14*256);
+
+	auto x = noise(many.block_size(), 1, 6);
+	std::vector<float> p1(one.bins(), 0), p15(many.bins(), 0);
+	one.accumulate(x, std::span(p1));
+	many.accumulate(x, std::span(p15));
+
+	double m1, s1, m15, s15;
+	mean_and_spread(p1, &m1, &s1);
+	mean_and_spread(p15, &m15, &s15);
+	CHECK(s1 > 0.8);
+	CHECK(s15 < 0.35);
+}
+
+static void test_tone() {
+	// A tone on bin 100 peaks there at A^2/4 * N/ENBW (the power scale
+	// spreads a tone's energy over the window's noise bandwidth), and
+	// accumulate() adds to what's already in the output
+	const std::size_t nfft = 1024;
+	const double a = 0.5;
+	rtlsdr::WelchPsd<float> psd(nfft, 4, 0.5, {rtlsdr::WindowType::BlackmanHarris});
+
+	std::vector<float> x(psd.block_size());
+	for (std::size_t i = 0; i < x.size(); i++) {
+		x[i] = a * std::cos(2*std::numbers::pi * 100 * i / nfft);
+	}
+
+	std::vector<float> p(psd.bins(), 1.0f);
+	psd.accumulate(x, std::span(p));
+
+	auto peak = std::max_element(std::begin(p), std::end(p)) - std::begin(p);
+	CHECK(peak == 100);
+
+	double expect = a*a/4 * nfft / psd.current_window().enbw();
+	CHECK(std::abs((p[100] - 1) / expect - 1) < 1e-3);
+	CHECK(std::abs(p[300] - 1) < 1e-3);
+}
+
+static void test_errors() {
+	rtlsdr::WelchPsd<float> psd(256, 2, 0.5);
+	std::vector<float> x(psd.block_size() - 1), p(psd.bins());
+
+	bool threw = false;
+	try {
+		psd.accumulate(x, std::span(p));
+	}
+	catch (const std::length_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+
+	threw = false;
+	try {
+		rtlsdr::WelchPsd<float> bad(256, 2, 1.0);
+	}
+	catch (const std::invalid_argument&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+int main() {
+	test_noise_level();
+	test_averaging();
+	test_tone();
+	test_errors();
+	return report();
+}
@@ -0,0 +1,129 @@
+// RasterAverager and estimate_frame_period: a frame buried in noise comes
+// back out, skipping lost samples keeps it in phase, and the actual frame
+// period is found from a nominal one that's off by a few tenths of a
+// percent
+
+#include <vector>
+#include <span>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include "raster.hpp"
+#include "check.hpp"
+
+static const std::size_t XT = 16, YT = 8;
+
+static int level(std::size_t x) { return x < XT/2 ? 200 : 50; }
+
+static double worst_error(const rtlsdr::RasterAverager& raster) {
+	std::vector<float> img(XT*YT);
+	raster.image(img, XT, YT);
+
+	double worst = 0;
+	for (std::size_t i = 0; i < img.size(); i++) {
+		worst = std::max(worst, std::abs(img[i] - (level(i % XT)/127.5 - 1)));
+	}
+	return worst;
+}
+
+static std::vector<unsigned char> noisy_frames(std::size_t nframes, unsigned seed) {
+	// A 16x8 frame (bright left half, dark right half), one sample per
+	// pixel, in noise
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> noise(-40, 40);
+
+	std::vector<unsigned char> x(nframes * XT*YT);
+	for (std::size_t i = 0; i < x.size(); i++) {
+		x[i] = static_cast<unsigned char>(level(i % XT) + noise(rng));
+	}
+	return x;
+}
+
+static void test_average() {
+	rtlsdr::DisplayTiming timing{1e6, XT, YT};
+	rtlsdr::RasterAverager raster(timing, 1e6);
+	CHECK(raster.frame_period() == XT*YT);
+
+	auto x = noisy_frames(300, 2);
+	for (std::size_t i = 0; i < x.size(); i += XT*YT) {
+		raster.push(std::span<const unsigned char>(x).subspan(i, XT*YT));
+	}
+	CHECK(raster.frames() == 300);
+	CHECK(worst_error(raster) < 0.05);
+}
+
+static void test_skip() {
+	// Drop odd-sized holes out of the stream; skipping them keeps every
+	// later sample on its own pixel, pushing on regardless doesn't
+	rtlsdr::DisplayTiming timing{1e6, XT, YT};
+	rtlsdr::RasterAverager skipped(timing, 1e6), smeared(timing, 1e6);
+
+	auto x = noisy_frames(300, 3);
+	std::span<const unsigned char> all(x);
+	for (std::size_t i = 0; i < x.size();) {
+		std::size_t keep = std::min<std::size_t>(777, x.size() - i);
+		skipped.push(all.subspan(i, keep));
+		smeared.push(all.subspan(i, keep));
+		i += keep;
+
+		std::size_t hole = std::min<std::size_t>(13, x.size() - i);
+		skipped.skip(hole);
+		i += hole;
+	}
+
+	CHECK(skipped.frames() == 300);
+	CHECK(worst_error(skipped) < 0.05);
+	CHECK(worst_error(smeared) > 0.2);
+}
+
+static void test_estimate() {
+	// A "display" whose frame lasts 9999.37 samples: every sample reads a
+	// fixed random picture (linearly interpolated between its pixels) at
+	// its time within the frame, plus noise. Nominal timing is 0.3% off.
+	const double period = 9999.37, nominal = period * 1.003;
+	const std::size_t nframes = 16;
+
+	std::mt19937 rng(4);
+	std::uniform_real_distribution<double> pixel(40, 215);
+	std::normal_distribution<double> noise(0, 10);
+
+	std::vector<double> picture(std::size_t(period) + 2);
+	for (auto& p: picture) {
+		p = pixel(rng);
+	}
+
+	std::vector<unsigned char> x(nframes * period);
+	for (std::size_t i = 0; i < x.size(); i++) {
+		double t = std::fmod(double(i), period);
+		std::size_t k = t;
+		double v = picture[k] + (t - k) * (picture[k + 1] - picture[k]) + noise(rng);
+		x[i] = static_cast<unsigned char>(std::clamp(v, 0.0, 255.0));
+	}
+
+	double est = rtlsdr::estimate_frame_period(x, nominal);
+	CHECK(std::abs(est - period) < 0.02);
+
+	// Outside the tolerance it isn't found
+	double off = rtlsdr::estimate_frame_period(x, period * 1.02, 0.005);
+	CHECK(std::abs(off - period) > 10);
+
+	bool threw = false;
+	try {
+		rtlsdr::estimate_frame_period(std::span<const unsigned char>(x).first(std::size_t(period)), nominal);
+	}
+	catch (const std::length_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+int main() {
+	SKIP_WITHOUT_HOST_SIMD();
+
+	test_average();
+	test_skip();
+	test_estimate();
+	return report();
+}
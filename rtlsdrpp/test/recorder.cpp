@@ -0,0 +1,205 @@
+// IqRecorder: bytes and SigMF metadata round trip, and capture segments
+// taken from stream block stamps
+
+#include <vector>
+#include <string>
+#include <complex>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include "recorder.hpp"
+#include "capture.hpp"
+#include "check.hpp"
+
+static std::string temp_base(const std::string& name) {
+	return (std::filesystem::temp_directory_path() / name).string();
+}
+
+static std::string slurp(const std::string& path) {
+	std::ifstream fin(path, std::ios::binary);
+	std::stringstream ss;
+	ss << fin.rdbuf();
+	return ss.str();
+}
+
+static void remove_recording(const std::string& base) {
+	std::filesystem::remove(base + ".sigmf-data");
+	std::filesystem::remove(base + ".sigmf-meta");
+}
+
+static void test_sigmf_round_trip() {
+	// Bytes recorded by IqRecorder read back unchanged through the SigMF
+	// sidecar, chunk boundaries and the final partial chunk included
+	std::string base = temp_base("rtlsdrpp_test_round_trip");
+
+	std::vector<unsigned char> bytes(3*4096 + 1000);
+	for (std::size_t i = 0; i < bytes.size(); i++) {
+		bytes[i] = static_cast<unsigned char>(i * 7 + i / 256);
+	}
+
+	{
+		rtlsdr::IqRecorder rec(base, 4096, 4);
+		rec.set_sample_rate(2400000);
+		rec.mark_retune(100000000);
+		rec.write(std::span<const unsigned char>(bytes).first(5000));
+		rec.write(std::span<const unsigned char>(bytes).subspan(5000));
+		rec.close();
+		CHECK(rec.bytes_written() == bytes.size());
+	}
+
+	std::string meta = slurp(base + ".sigmf-meta");
+	CHECK(meta.find("\"core:sample_rate\": 2400000") != std::string::npos);
+	CHECK(meta.find("\"core:frequency\": 100000000") != std::string::npos);
+
+	{
+		rtlsdr::CaptureReader cap(base + ".sigmf-data", 1000);
+		CHECK(cap.format() == rtlsdr::SampleFormat::CU8);
+		CHECK(cap.num_samples() == bytes.size()/2);
+		CHECK(std::equal(std::begin(bytes), std::end(bytes), std::begin(cap.raw()), std::end(cap.raw())));
+
+		std::vector<std::complex<float>> iq(cap.num_samples());
+		CHECK(cap.read(0, std::span(iq)) == iq.size());
+
+		double worst = 0;
+		for (std::size_t i = 0; i < iq.size(); i++) {
+			std::complex<double> ref(bytes[2*i]/127.5 - 1, bytes[2*i+1]/127.5 - 1);
+			worst = std::max(worst, std::abs(std::complex<double>(iq[i]) - ref));
+		}
+		CHECK(worst < 1e-6);
+	}
+
+	remove_recording(base);
+}
+
+struct FakeStream {
+	// Stands in for a streaming RtlSdr: hands out stamped blocks, some
+	// with gaps or retunes between them
+	struct Block {
+		std::vector<unsigned char> data;
+		rtlsdr::BlockInfo info;
+	};
+
+	std::vector<Block> blocks;
+	std::size_t cur = 0, off = 0;
+
+	void add(std::uint64_t sample_index, std::uint32_t freq, std::uint32_t retunes, std::size_t len) {
+		Block b;
+		b.data.resize(len);
+		for (std::size_t i = 0; i < len; i++) {
+			b.data[i] = static_cast<unsigned char>(sample_index + i);
+		}
+		b.info.sample_index = sample_index;
+		b.info.host_ns = rtlsdr::monotonic_ns();
+		b.info.tuner.center_freq = freq;
+		b.info.tuner.retunes = retunes;
+		b.info.tuner.gain = 30;
+		blocks.push_back(std::move(b));
+	}
+
+	std::size_t read_stream_block(unsigned char* dest, std::size_t max_bytes, rtlsdr::BlockInfo* info) {
+		if (cur == blocks.size()) {
+			return 0;
+		}
+
+		const Block& b = blocks[cur];
+		*info = b.info;
+		info->sample_index += off/2;
+
+		std::size_t n = std::min(max_bytes, b.data.size() - off);
+		std::copy_n(b.data.data() + off, n, dest);
+		off += n;
+		if (off == b.data.size()) {
+			cur++;
+			off = 0;
+		}
+		return n;
+	}
+};
+
+static void test_record_segments() {
+	// Segments start at the first block, after dropped blocks and after a
+	// retune, at the right file offset whatever was buffered when the
+	// tuning changed; a segment marked before recording is superseded
+	std::string base = temp_base("rtlsdrpp_test_segments");
+
+	FakeStream stream;
+	stream.add(0, 100000000, 3, 1000);
+	stream.add(500, 100000000, 3, 1000);
+	stream.add(1000, 100000000, 3, 1000);
+	stream.add(2000, 100000000, 3, 1000); // 500 samples dropped before this
+	stream.add(2500, 101000000, 4, 1000); // retuned
+	stream.add(3000, 101000000, 4, 1000);
+
+	std::vector<unsigned char> expect;
+	for (const auto& b: stream.blocks) {
+		expect.insert(std::end(expect), std::begin(b.data), std::end(b.data));
+	}
+
+	{
+		rtlsdr::IqRecorder rec(base, 4096, 2);
+		rec.mark_retune(99000000);
+
+		// Odd-sized reads split blocks, so later stamps are mid-block
+		CHECK(rec.record(stream, 2700) == 2700);
+		CHECK(rec.record(stream, 10000) == 3300);
+		rec.close();
+	}
+
+	CHECK(slurp(base + ".sigmf-data") == std::string(std::begin(expect), std::end(expect)));
+
+	std::string meta = slurp(base + ".sigmf-meta");
+	CHECK(meta.find("99000000") == std::string::npos);
+	CHECK(meta.find("{\"core:sample_start\": 0, \"core:frequency\": 100000000, \"core:global_index\": 0,") != std::string::npos);
+	CHECK(meta.find("{\"core:sample_start\": 1500, \"core:frequency\": 100000000, \"core:global_index\": 2000,") != std::string::npos);
+	CHECK(meta.find("{\"core:sample_start\": 2000, \"core:frequency\": 101000000, \"core:global_index\": 2500,") != std::string::npos);
+	CHECK(std::count(std::begin(meta), std::end(meta), '{') == 5); // top level, global, 3 captures
+	CHECK(meta.find("\"rtlsdrpp:gain\": 30") != std::string::npos);
+
+	remove_recording(base);
+}
+
+static void test_backpressure() {
+	// Far more data than the ring holds: the producer sleeps on the writer
+	// and nothing is lost
+	std::string base = temp_base("rtlsdrpp_test_backpressure");
+	std::vector<unsigned char> bytes(1 << 20);
+	for (std::size_t i = 0; i < bytes.size(); i++) {
+		bytes[i] = static_cast<unsigned char>(i / 4096);
+	}
+
+	{
+		rtlsdr::IqRecorder rec(base, 4096, 2);
+		for (std::size_t i = 0; i < bytes.size(); i += 3000) {
+			rec.write(std::span<const unsigned char>(bytes).subspan(i, std::min<std::size_t>(3000, bytes.size() - i)));
+		}
+		rec.close();
+		CHECK(rec.bytes_written() == bytes.size());
+	}
+
+	CHECK(slurp(base + ".sigmf-data") == std::string(std::begin(bytes), std::end(bytes)));
+	remove_recording(base);
+}
+
+static void test_chunk_size() {
+	bool threw = false;
+	try {
+		rtlsdr::IqRecorder rec(temp_base("rtlsdrpp_test_chunk"), 1000, 4);
+	}
+	catch (const std::invalid_argument&) {
+		threw = true;
+	}
+	CHECK(threw);
+	CHECK(!std::filesystem::exists(temp_base("rtlsdrpp_test_chunk") + ".sigmf-data"));
+}
+
+int main() {
+	test_sigmf_round_trip();
+	test_record_segments();
+	test_backpressure();
+	test_chunk_size();
+	return report();
+}
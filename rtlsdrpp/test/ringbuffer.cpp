@@ -0,0 +1,92 @@
+// BlockRing: capacity, drops when full, ordering across wraps, and
+// sleeping on an empty ring until the producer commits
+
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include "ringbuffer.hpp"
+#include "check.hpp"
+
+static void test_wrap_and_drop() {
+	// Capacity rounds up to a power of two; a full ring drops pushes, and
+	// blocks come out in order with their lengths across many wraps
+	rtlsdr::BlockRing ring(8, 3);
+	CHECK(ring.capacity() == 4);
+
+	unsigned char in[8];
+	std::size_t next_out = 0;
+
+	for (std::size_t seq = 0; seq < 40; seq++) {
+		std::fill(std::begin(in), std::end(in), static_cast<unsigned char>(seq));
+		CHECK(ring.push(in, 1 + seq % 8));
+
+		if (ring.size() == ring.capacity()) {
+			CHECK(ring.write_slot() == nullptr);
+			CHECK(!ring.push(in, 8));
+
+			// Drain all but one so the indices wrap at a different offset
+			while (ring.size() > 1) {
+				std::size_t len = 0;
+				const unsigned char* blk = ring.front(&len);
+				CHECK(blk != nullptr);
+				CHECK(len == 1 + next_out % 8);
+				CHECK(blk[0] == static_cast<unsigned char>(next_out) && blk[len-1] == blk[0]);
+				ring.pop();
+				next_out++;
+			}
+		}
+	}
+
+	CHECK(ring.write_index() == 40);
+	ring.clear();
+	CHECK(ring.empty() && ring.front() == nullptr);
+}
+
+static void test_wait() {
+	// A consumer asleep in wait_until() wakes for every block, and a
+	// producer blocked on a full ring wakes when the consumer pops
+	rtlsdr::BlockRing ring(4, 2);
+	const std::size_t nblocks = 200;
+
+	std::thread producer([&]() {
+		for (std::size_t i = 0; i < nblocks; i++) {
+			ring.wait_until([&]() { return ring.size() < ring.capacity(); });
+
+			unsigned char b[4] = {static_cast<unsigned char>(i)};
+			ring.push(b, 1);
+
+			if (i % 50 == 0) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			}
+		}
+	});
+
+	bool in_order = true;
+	for (std::size_t i = 0; i < nblocks; i++) {
+		ring.wait_until([&]() { return !ring.empty(); });
+		in_order = in_order && ring.front()[0] == static_cast<unsigned char>(i);
+		ring.pop();
+	}
+	producer.join();
+
+	CHECK(in_order);
+	CHECK(ring.empty());
+
+	// A flag set by a third party, followed by wake(), ends the wait too
+	bool stop = false;
+	std::thread stopper([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		stop = true;
+		ring.wake();
+	});
+	ring.wait_until([&]() { return !ring.empty() || stop; });
+	stopper.join();
+	CHECK(stop && ring.empty());
+}
+
+int main() {
+	test_wrap_and_drop();
+	test_wait();
+	return report();
+}
@@ -0,0 +1,133 @@
+// Backends that need no dongle: where SyntheticSdr puts its tones in I/Q
+// and direct sampling modes, and ReplaySdr playback
+
+#include <vector>
+#include <string>
+#include <complex>
+#include <numbers>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <cmath>
+
+#include "sources.hpp"
+#include "check.hpp"
+
+static double real_power(const std::vector<unsigned char>& bytes, double f, double fs) {
+	// |DFT|^2 / n^2 of real u8 samples at one frequency
+	std::complex<double> acc = 0;
+	for (std::size_t i = 0; i < bytes.size(); i++) {
+		acc += (bytes[i]/127.5 - 1) * std::polar(1.0, -2*std::numbers::pi * f * i / fs);
+	}
+	return std::norm(acc) / (double(bytes.size()) * bytes.size());
+}
+
+static double iq_power(const std::vector<unsigned char>& bytes, double f, double fs) {
+	// Same for interleaved u8 I/Q, where the sign of f matters
+	std::complex<double> acc = 0;
+	for (std::size_t i = 0; i < bytes.size()/2; i++) {
+		std::complex<double> s(bytes[2*i]/127.5 - 1, bytes[2*i+1]/127.5 - 1);
+		acc += s * std::polar(1.0, -2*std::numbers::pi * f * i / fs);
+	}
+	return std::norm(acc) / std::pow(bytes.size()/2.0, 2);
+}
+
+static void test_synthetic_iq() {
+	// An I/Q tone sits at its offset from the center frequency, on the
+	// correct side of it
+	const double fs = 2.4e6;
+	rtlsdr::SyntheticSdr synth({{100.2e6, 0.25}});
+	synth.set_sample_rate(fs);
+	synth.set_center_freq(100e6);
+	synth.set_gain(20);
+
+	std::vector<unsigned char> bytes(2*24000);
+	synth.read_bytes(std::span(bytes));
+
+	CHECK(std::abs(iq_power(bytes, 200e3, fs) - 0.0625) < 0.005);
+	CHECK(iq_power(bytes, -200e3, fs) < 1e-4);
+}
+
+static void test_synthetic_direct() {
+	// Direct sampling follows librtlsdr: the center frequency is the IF,
+	// so a tone shows at f - f_c as a real cosine of amplitude A (|X|^2 =
+	// A^2/4), not at its absolute frequency
+	const double fs = 2.4e6;
+	rtlsdr::SyntheticSdr synth({{1.3e6, 0.25}});
+	synth.set_sample_rate(fs);
+	synth.set_direct_sampling(2);
+	synth.set_center_freq(1e6);
+	synth.set_gain(20);
+
+	std::vector<unsigned char> bytes(24000);
+	synth.read_bytes(std::span(bytes));
+
+	CHECK(std::abs(real_power(bytes, 300e3, fs) - 0.015625) < 0.002);
+	CHECK(real_power(bytes, 1.1e6, fs) < 1e-4);
+
+	// Retuning moves it
+	synth.set_center_freq(0.9e6);
+	synth.read_bytes(std::span(bytes));
+	CHECK(std::abs(real_power(bytes, 400e3, fs) - 0.015625) < 0.002);
+	CHECK(real_power(bytes, 300e3, fs) < 1e-4);
+}
+
+static void test_replay() {
+	// A capture loops byte for byte and refuses to be replayed at a rate it
+	// wasn't taken at
+	std::string path = (std::filesystem::temp_directory_path() / "rtlsdrpp_test_replay.bin").string();
+	{
+		std::ofstream out(path, std::ios::binary);
+		for (int i = 0; i < 1000; i++) {
+			out.put(static_cast<char>(i % 251));
+		}
+	}
+
+	{
+		rtlsdr::ReplaySdr replay(path, true, 1024000);
+		CHECK(replay.get_sample_rate() == 1024000);
+
+		std::vector<unsigned char> bytes(2500);
+		replay.read_bytes(std::span(bytes));
+
+		bool same = true;
+		for (std::size_t i = 0; i < bytes.size(); i++) {
+			same = same && bytes[i] == (i % 1000) % 251;
+		}
+		CHECK(same);
+		CHECK(replay.tell() == 500);
+
+		bool threw = false;
+		try {
+			replay.set_sample_rate(2400000);
+		}
+		catch (const std::invalid_argument&) {
+			threw = true;
+		}
+		CHECK(threw);
+	}
+
+	std::filesystem::remove(path);
+}
+
+static void test_open_backend() {
+	auto sdr = rtlsdr::open_backend("synth:1e6,2e6", {.sample_rate = 1024000});
+	CHECK(sdr->get_sample_rate() == 1024000);
+
+	bool threw = false;
+	try {
+		rtlsdr::open_backend("bogus");
+	}
+	catch (const std::invalid_argument&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+int main() {
+	test_synthetic_iq();
+	test_synthetic_direct();
+	test_replay();
+	test_open_backend();
+	return report();
+}
@@ -0,0 +1,107 @@
+// Spectrogram: frames come every hop whatever the block sizes, each one
+// sees the last nfft samples (including with hop > nfft), and the ring and
+// features keep time order
+
+#include <vector>
+#include <span>
+#include <numbers>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include "spectrogram.hpp"
+#include "check.hpp"
+
+// A tone on bin K whose amplitude steps up once per hop, timed so that
+// frame j (j > 0) sees amplitude j+1 throughout when hop >= nfft
+static const std::size_t K = 37;
+
+static std::vector<float> stepped_tone(std::size_t n, std::size_t nfft, std::size_t hop) {
+	std::vector<float> x(n);
+	for (std::size_t i = 0; i < n; i++) {
+		double amp = i < nfft ? 1 : 2 + (i - nfft)/hop;
+		x[i] = amp * std::cos(2*std::numbers::pi * K * i / nfft);
+	}
+	return x;
+}
+
+static void test_frame_count() {
+	// Frames at nfft, nfft + hop, ... however the input is split
+	const std::size_t nfft = 256;
+	for (std::size_t hop: {64, 256, 1000}) {
+		rtlsdr::Spectrogram<float> whole(nfft, hop, 100), split(nfft, hop, 100);
+		auto x = stepped_tone(20000, nfft, hop);
+
+		std::size_t made = whole.push(x);
+		std::size_t expect = 1 + (x.size() - nfft)/hop;
+		CHECK(made == expect && whole.total_frames() == expect);
+
+		made = 0;
+		for (std::size_t i = 0, step = 1; i < x.size(); i += step, step = step*5 % 997 + 1) {
+			made += split.push(std::span<const float>(x).subspan(i, std::min(step, x.size() - i)));
+		}
+		CHECK(made == expect);
+
+		bool same = true;
+		for (std::size_t f = 0; f < whole.frames(); f++) {
+			same = same && std::equal(std::begin(whole.frame(f)), std::end(whole.frame(f)), std::begin(split.frame(f)));
+		}
+		CHECK(same);
+	}
+}
+
+static void test_sparse_hop() {
+	// hop > nfft: frame j sees only samples of amplitude j+1, so the tone
+	// bin's power goes as (j+1)^2. The ring keeps the last four.
+	const std::size_t nfft = 256, hop = 600, cap = 4;
+	rtlsdr::Spectrogram<float> stft(nfft, hop, cap);
+	CHECK(stft.bins() == nfft/2);
+
+	auto x = stepped_tone(nfft + 9*hop, nfft, hop);
+	CHECK(stft.push(x) == 10);
+	CHECK(stft.frames() == cap && stft.total_frames() == 10);
+
+	double ref = stft.frame(0)[K] / 49.0; // frame 6, amplitude 7
+	double worst = 0;
+	for (std::size_t f = 0; f < cap; f++) {
+		double amp = 7 + f;
+		worst = std::max(worst, std::abs(stft.frame(f)[K] / (amp*amp) - ref) / ref);
+
+		// Nothing leaks far from the tone
+		CHECK(stft.frame(f)[K + 20] < 1e-6 * stft.frame(f)[K]);
+	}
+	CHECK(worst < 1e-4);
+	CHECK(stft.latest().data() == stft.frame(cap - 1).data());
+
+	// Time slices come out oldest first
+	std::vector<float> feat(2 * 4);
+	stft.features(feat, 2, 4);
+	CHECK(feat[4 + K*4/stft.bins()] > feat[K*4/stft.bins()]);
+
+	std::vector<float> mat(cap * stft.bins());
+	stft.matrix(mat);
+	CHECK(std::equal(std::begin(stft.frame(2)), std::end(stft.frame(2)), std::begin(mat) + 2*stft.bins()));
+
+	bool threw = false;
+	try {
+		stft.frame(cap);
+	}
+	catch (const std::out_of_range&) {
+		threw = true;
+	}
+	CHECK(threw);
+
+	// After a reset the next frame needs a whole nfft of new samples
+	stft.reset();
+	CHECK(stft.frames() == 0);
+	CHECK(stft.push(std::span<const float>(x).first(nfft - 1)) == 0);
+	CHECK(stft.push(std::span<const float>(x).subspan(nfft - 1, 1)) == 1);
+}
+
+int main() {
+	SKIP_WITHOUT_HOST_SIMD();
+
+	test_frame_count();
+	test_sparse_hop();
+	return report();
+}
@@ -0,0 +1,159 @@
+// ThreadPool: every task runs once with a valid worker index, full queues
+// make submitters wait or run inline, errors come back through wait(), and
+// steady-state submission never allocates
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+#include <cstdlib>
+#include <new>
+
+#include "threadpool.hpp"
+#include "check.hpp"
+
+// Counts heap allocations made while `counting` is set
+static std::atomic<bool> counting{false};
+static std::atomic<std::size_t> allocations{0};
+
+void* operator new(std::size_t n) {
+	if (counting.load(std::memory_order_relaxed)) {
+		allocations.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (void* p = std::malloc(n ? n : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+static void test_parallel_for() {
+	rtlsdr::ThreadPool pool(4);
+	CHECK(pool.num_slots() == 4);
+
+	std::vector<std::atomic<int>> hits(10000);
+	std::atomic<bool> bad_worker{false};
+	pool.parallel_for(hits.size(), [&](std::size_t w, std::size_t i) {
+		if (w >= 4) {
+			bad_worker = true;
+		}
+		hits[i]++;
+	});
+
+	bool once = true;
+	for (auto& h: hits) {
+		once = once && h == 1;
+	}
+	CHECK(once);
+	CHECK(!bad_worker);
+}
+
+static void test_full_queues() {
+	// Two workers with 4 slots each: an outside submitter has to wait for
+	// room, and a worker fanning out more than its queue holds runs the
+	// overflow itself
+	rtlsdr::ThreadPool pool(2, 4);
+	std::atomic<int> count{0};
+
+	for (int i = 0; i < 1000; i++) {
+		pool.submit([&count](std::size_t) { count++; });
+	}
+	pool.wait();
+	CHECK(count == 1000);
+
+	count = 0;
+	pool.submit([&pool, &count](std::size_t) {
+		for (int i = 0; i < 100; i++) {
+			pool.submit([&count](std::size_t) { count++; });
+		}
+	});
+	pool.wait();
+	CHECK(count == 100);
+}
+
+static void test_errors() {
+	rtlsdr::ThreadPool pool(3);
+	for (int i = 0; i < 10; i++) {
+		pool.submit([i](std::size_t) {
+			if (i % 3 == 0) {
+				throw std::runtime_error("task failed");
+			}
+		});
+	}
+
+	bool threw = false;
+	try {
+		pool.wait();
+	}
+	catch (const std::runtime_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+
+	// Reported once only
+	pool.wait();
+
+	// No workers: tasks run on the caller as worker 0
+	rtlsdr::ThreadPool inline_pool(0);
+	CHECK(inline_pool.num_slots() == 1);
+	std::thread::id ran_on;
+	inline_pool.submit([&ran_on](std::size_t w) { ran_on = std::this_thread::get_id(); CHECK(w == 0); });
+	CHECK(ran_on == std::this_thread::get_id());
+}
+
+static void test_task() {
+	// Captures are moved, not copied, and destroyed exactly once
+	struct Tracked {
+		int* live;
+		Tracked(int* l): live(l) { ++*live; }
+		Tracked(Tracked&& o) noexcept: live(o.live) { ++*live; }
+		~Tracked() { --*live; }
+	};
+
+	int live = 0;
+	{
+		rtlsdr::PoolTask a([t = Tracked(&live)](std::size_t) {});
+		CHECK(live == 1);
+
+		rtlsdr::PoolTask b(std::move(a));
+		CHECK(live == 1 && !a && b);
+
+		b.reset();
+		CHECK(live == 0 && !b);
+	}
+	CHECK(live == 0);
+}
+
+static void test_no_allocation() {
+	// Once the pool is built, a sweep's worth of submits with captures the
+	// size of the server's (~40 bytes) allocates nothing
+	rtlsdr::ThreadPool pool(4);
+	std::vector<double> out(512);
+	const double* src = out.data();
+
+	auto sweep = [&]() {
+		for (std::size_t i = 0; i < out.size(); i++) {
+			pool.submit([&out, src, i, a = 1.0, b = 2.0](std::size_t) { out[i] = src[0]*0 + a + b + i; });
+		}
+		pool.wait();
+	};
+
+	sweep();
+	counting = true;
+	sweep();
+	counting = false;
+
+	CHECK(allocations == 0);
+	CHECK(out[511] == 514);
+}
+
+int main() {
+	test_parallel_for();
+	test_full_queues();
+	test_errors();
+	test_task();
+	test_no_allocation();
+	return report();
+}
@@ -0,0 +1,118 @@
+// Window taps and normalization constants against their textbook values,
+// and scalloping of a tone between bins
+
+#include <vector>
+#include <complex>
+#include <numbers>
+#include <stdexcept>
+#include <cmath>
+
+#include "window.hpp"
+#include "check.hpp"
+
+static bool close_to(double a, double b, double tol) { return std::abs(a - b) <= tol; }
+
+static void test_parse() {
+	CHECK(rtlsdr::parse_window("rect").type == rtlsdr::WindowType::Rectangular);
+	CHECK(rtlsdr::parse_window("welch").type == rtlsdr::WindowType::Welch);
+	CHECK(rtlsdr::parse_window("blackman-harris").type == rtlsdr::WindowType::BlackmanHarris);
+	CHECK(rtlsdr::parse_window("flattop").type == rtlsdr::WindowType::FlatTop);
+	CHECK(rtlsdr::parse_window("kaiser:5").beta == 5);
+
+	for (const char* bad: {"hann:2", "triangle"}) {
+		bool threw = false;
+		try {
+			rtlsdr::parse_window(bad);
+		}
+		catch (const std::invalid_argument&) {
+			threw = true;
+		}
+		CHECK(threw);
+	}
+}
+
+static void test_constants() {
+	// Coherent gain and ENBW (bins) of the periodic windows, N large
+	const std::size_t n = 4096;
+	struct Expect { rtlsdr::WindowSpec spec; double cg, enbw; };
+	const Expect table[] = {
+		{{rtlsdr::WindowType::Rectangular}, 1.0, 1.0},
+		{{rtlsdr::WindowType::Welch}, 2.0/3, 1.2},
+		{{rtlsdr::WindowType::Hann}, 0.5, 1.5},
+		{{rtlsdr::WindowType::BlackmanHarris}, 0.35875, 2.0044},
+		{{rtlsdr::WindowType::FlatTop}, 0.21557895, 3.7702},
+		{{rtlsdr::WindowType::Kaiser, 0}, 1.0, 1.0},
+	};
+
+	for (const auto& e: table) {
+		rtlsdr::Window<float> w(e.spec, n);
+		CHECK(close_to(w.coherent_gain(), e.cg, 1e-3));
+		CHECK(close_to(w.enbw(), e.enbw, 2e-3));
+		CHECK(close_to(w.amplitude_scale(), 1 / std::pow(n * w.coherent_gain(), 2), 1e-12));
+	}
+
+	// Periodic, not symmetric: Hann starts at 0 and peaks at N/2
+	rtlsdr::Window<float> hann({rtlsdr::WindowType::Hann}, 8);
+	CHECK(hann.taps()[0] == 0);
+	CHECK(close_to(hann.taps()[4], 1, 1e-7));
+	CHECK(close_to(hann.taps()[1], hann.taps()[7], 1e-7));
+}
+
+static double tone_reading_db(rtlsdr::WindowType type, double offset) {
+	// A unit real tone `offset` bins from bin 64, read at bin 64 through
+	// the window's amplitude scale, in dB relative to its true power
+	const std::size_t n = 1024;
+	rtlsdr::Window<float> w({type}, n);
+	rtlsdr::RealFft<float> fft(n);
+
+	std::vector<float> x(n);
+	for (std::size_t i = 0; i < n; i++) {
+		x[i] = std::cos(2*std::numbers::pi * (64 + offset) * i / n);
+	}
+	w.apply(std::span(x));
+
+	std::vector<std::complex<float>> X(fft.bins());
+	fft.forward(std::span<const float>(x), std::span(X));
+
+	// A real cosine puts a quarter of its A^2 power in each half
+	return 10*std::log10(4 * std::norm(X[64]) * w.amplitude_scale());
+}
+
+static void test_scalloping() {
+	CHECK(close_to(tone_reading_db(rtlsdr::WindowType::Hann, 0), 0, 0.01));
+	CHECK(close_to(tone_reading_db(rtlsdr::WindowType::Hann, 0.5), -1.42, 0.03));
+	CHECK(close_to(tone_reading_db(rtlsdr::WindowType::FlatTop, 0.5), 0, 0.02));
+}
+
+static void test_apply() {
+	const std::size_t n = 100;
+	const auto& w = rtlsdr::get_window<float>({rtlsdr::WindowType::Hann}, n);
+	CHECK(&w == &rtlsdr::get_window<float>({rtlsdr::WindowType::Hann}, n));
+
+	std::vector<float> x(n, 2.0f), y(n);
+	w.apply(std::span<const float>(x), std::span(y));
+	w.apply(std::span(x));
+
+	bool same = true;
+	for (std::size_t i = 0; i < n; i++) {
+		same = same && x[i] == y[i] && x[i] == 2*w.taps()[i];
+	}
+	CHECK(same);
+
+	bool threw = false;
+	try {
+		w.apply(std::span(x).first(n - 1));
+	}
+	catch (const std::length_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+int main() {
+	test_parse();
+	test_constants();
+	test_scalloping();
+	test_apply();
+	return report();
+}
@@ -0,0 +1,62 @@
+#ifndef RTLSDRPP_ALIGNED_HPP
+#define RTLSDRPP_ALIGNED_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <new>
+#include <cstddef>
+
+namespace rtlsdr {
+
+const std::size_t PAGE_ALIGN = 4096;
+
+template <typename T, std::size_t Align=64>
+struct AlignedAllocator {
+	// Storage aligned to `Align` bytes: cache lines for SIMD work buffers,
+	// pages for buffers handed to the kernel
+	using value_type = T;
+
+	template <typename U>
+	struct rebind { using other = AlignedAllocator<U, Align>; };
+
+	AlignedAllocator() = default;
+
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+	T* allocate(std::size_t n) {
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+	}
+
+	void deallocate(T* p, std::size_t) {
+		::operator delete(p, std::align_val_t(Align));
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Align>&) const { return true; }
+};
+
+template <typename T>
+using aligned_vector = std::vector<T, AlignedAllocator<T>>;
+
+template <typename T>
+using page_aligned_vector = std::vector<T, AlignedAllocator<T, PAGE_ALIGN>>;
+
+} // namespace rtlsdr
+
+#endif
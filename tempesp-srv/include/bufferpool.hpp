@@ -0,0 +1,137 @@
+#ifndef RTLSDRPP_BUFFERPOOL_HPP
+#define RTLSDRPP_BUFFERPOOL_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <span>
+#include <mutex>
+#include <utility>
+
+#include "aligned.hpp"
+
+namespace rtlsdr {
+
+template <typename T>
+class BufferPool {
+	// Recycles sample buffers so steady-state code never hits the heap
+	//
+	// `acquire(n)` hands out a Buffer with room for n samples, reusing a
+	// returned one when possible. The Buffer goes back to the pool when it
+	// is destroyed or released, from any thread. Once the pool holds its
+	// working set (grown by the first few calls, or up front by
+	// `reserve()`), acquire/release are just a locked vector swap.
+	//
+	// Storage is cache-line aligned, like the other DSP work buffers.
+	//
+	// Notes:
+	//	The pool must outlive every Buffer taken from it.
+	//
+public:
+	class Buffer {
+	public:
+		Buffer() = default;
+		Buffer(BufferPool* pool_, aligned_vector<T>&& v, std::size_t n): pool(pool_), vec(std::move(v)), len(n) {}
+
+		Buffer(Buffer&& o) noexcept: pool(o.pool), vec(std::move(o.vec)), len(o.len) { o.pool = nullptr; }
+
+		Buffer& operator=(Buffer&& o) noexcept {
+			if (this != &o) {
+				release();
+				pool = o.pool;
+				vec = std::move(o.vec);
+				len = o.len;
+				o.pool = nullptr;
+			}
+			return *this;
+		}
+
+		Buffer(const Buffer&) = delete;
+		Buffer& operator=(const Buffer&) = delete;
+
+		~Buffer() { release(); }
+
+		T* data() { return vec.data(); }
+		std::size_t size() const { return len; }
+		T& operator[](std::size_t i) { return vec[i]; }
+
+		std::span<T> span() { return {vec.data(), len}; }
+		operator std::span<T>() { return span(); }
+
+		void release() {
+			if (pool != nullptr) {
+				pool->give_back(std::move(vec));
+				pool = nullptr;
+			}
+		}
+
+	private:
+		BufferPool* pool = nullptr;
+		aligned_vector<T> vec;
+		std::size_t len = 0;
+	};
+
+	void reserve(std::size_t count, std::size_t n) {
+		// Fills the pool to `count` free buffers of at least n samples, so
+		// steady-state acquires don't have to grow it
+		std::lock_guard<std::mutex> lock(m);
+		free_list.reserve(count);
+		for (auto& v: free_list) {
+			if (v.size() < n) {
+				v.resize(n);
+			}
+		}
+		while (free_list.size() < count) {
+			free_list.emplace_back(n);
+		}
+	}
+
+	Buffer acquire(std::size_t n) {
+		aligned_vector<T> v;
+		{
+			std::lock_guard<std::mutex> lock(m);
+			if (!free_list.empty()) {
+				v = std::move(free_list.back());
+				free_list.pop_back();
+			}
+		}
+
+		if (v.size() < n) {
+			v.resize(n);
+		}
+
+		return Buffer(this, std::move(v), n);
+	}
+
+	std::size_t available() {
+		std::lock_guard<std::mutex> lock(m);
+		return free_list.size();
+	}
+
+private:
+	void give_back(aligned_vector<T>&& v) {
+		std::lock_guard<std::mutex> lock(m);
+		free_list.emplace_back(std::move(v));
+	}
+
+	std::mutex m;
+	std::vector<aligned_vector<T>> free_list;
+};
+
+} // namespace rtlsdr
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef RTLSDRPP_CAPTURE_HPP
+#define RTLSDRPP_CAPTURE_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <string>
+#include <span>
+#include <complex>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "convert.hpp"
+
+namespace rtlsdr {
+
+class MappedFile {
+	// Read-only mmap of a whole file
+public:
+	MappedFile(const std::string& path) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::runtime_error("Could not open capture \"" + path + "\": " + std::strerror(errno));
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) < 0 || st.st_size == 0) {
+			::close(fd);
+			throw std::runtime_error("Capture \"" + path + "\" is empty or unreadable");
+		}
+
+		len = st.st_size;
+		void* p = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+
+		if (p == MAP_FAILED) {
+			throw std::runtime_error("Could not mmap capture \"" + path + "\": " + std::strerror(errno));
+		}
+
+		madvise(p, len, MADV_SEQUENTIAL);
+		ptr = static_cast<const unsigned char*>(p);
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile() {
+		munmap(const_cast<unsigned char*>(ptr), len);
+	}
+
+	const unsigned char* data() const { return ptr; }
+	std::size_t size() const { return len; }
+	std::span<const unsigned char> bytes() const { return {ptr, len}; }
+
+private:
+	const unsigned char* ptr = nullptr;
+	std::size_t len = 0;
+};
+
+enum class SampleFormat {
+	CU8,  // rtl_sdr native: interleaved unsigned 8 bit I/Q, offset 127.5
+	CS8,  // interleaved signed 8 bit I/Q (HackRF, some converters)
+	CF32  // interleaved little endian float32 I/Q (GNU Radio, SigMF cf32_le)
+};
+
+inline std::size_t bytes_per_sample(SampleFormat fmt) {
+	return (fmt == SampleFormat::CF32) ? 2*sizeof(float) : 2;
+}
+
+inline SampleFormat guess_format(const std::string& path) {
+	// Uses the SigMF sidecar's core:datatype when there is one, otherwise
+	// the file extension. Anything unrecognized is treated as rtl_sdr cu8.
+	std::string meta_path = path;
+	auto dot = meta_path.rfind(".sigmf-data");
+	if (dot != std::string::npos) {
+		meta_path.replace(dot, std::string::npos, ".sigmf-meta");
+
+		std::ifstream fin(meta_path);
+		std::stringstream ss;
+		ss << fin.rdbuf();
+		std::string meta = ss.str();
+
+		auto key = meta.find("\"core:datatype\"");
+		if (key != std::string::npos) {
+			auto q0 = meta.find('"', meta.find(':', key + 15) + 1);
+			auto q1 = meta.find('"', q0 + 1);
+			std::string dtype = meta.substr(q0 + 1, q1 - q0 - 1);
+
+			if (dtype == "cu8") return SampleFormat::CU8;
+			if (dtype == "ci8" || dtype == "cs8") return SampleFormat::CS8;
+			if (dtype == "cf32_le" || dtype == "cf32") return SampleFormat::CF32;
+
+			throw std::runtime_error("Unsupported SigMF datatype \"" + dtype + "\"");
+		}
+	}
+
+	auto ends_with = [&](const std::string& ext) {
+		return path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+	};
+
+	if (ends_with(".cs8") || ends_with(".ci8")) return SampleFormat::CS8;
+	if (ends_with(".cf32") || ends_with(".fc32") || ends_with(".cfile")) return SampleFormat::CF32;
+
+	return SampleFormat::CU8;
+}
+
+class CaptureReader {
+	// Random access, chunked view of a binary I/Q capture
+	//
+	// The file is memory-mapped and nothing is converted up front, so
+	// opening a multi-GB capture is instant. `chunk()` converts one chunk
+	// into a reusable buffer on demand; cf32 files are handed out straight
+	// from the mapping with no conversion at all.
+	//
+	// Arguments:
+	//	path (str): Capture file (.bin/.cu8, .cs8, .cf32, or .sigmf-data)
+	//	chunk_samples: Samples per chunk for `chunk()` / `num_chunks()`
+	//
+public:
+	using complex = std::complex<float>;
+
+	CaptureReader(const std::string& path, std::size_t chunk_samples_=1 << 16):
+		CaptureReader(path, guess_format(path), chunk_samples_) {}
+
+	CaptureReader(const std::string& path, SampleFormat fmt_, std::size_t chunk_samples_=1 << 16):
+		file(path), fmt(fmt_), chunk_samples(chunk_samples_) {
+
+		if (chunk_samples == 0) {
+			throw std::invalid_argument("CaptureReader chunk size must be nonzero");
+		}
+	}
+
+	SampleFormat format() const { return fmt; }
+	std::size_t num_samples() const { return file.size() / bytes_per_sample(fmt); }
+	std::size_t chunk_size() const { return chunk_samples; }
+	std::size_t num_chunks() const { return (num_samples() + chunk_samples - 1) / chunk_samples; }
+
+	std::span<const unsigned char> raw() const { return file.bytes(); }
+
+	std::span<const complex> chunk(std::size_t i) {
+		// Samples of chunk i; valid until the next `chunk()` call
+		std::size_t first = i * chunk_samples;
+		if (first >= num_samples()) {
+			throw std::out_of_range("Chunk " + std::to_string(i) + " is past the end of the capture");
+		}
+
+		std::size_t n = std::min(chunk_samples, num_samples() - first);
+
+		if (fmt == SampleFormat::CF32) {
+			return {reinterpret_cast<const complex*>(file.data()) + first, n};
+		}
+
+		if (scratch.size() < n) {
+			scratch.resize(n);
+		}
+		read(first, std::span<complex>(scratch.data(), n));
+
+		return {scratch.data(), n};
+	}
+
+	template <typename T>
+	std::size_t read(std::size_t first, std::span<T> out) const {
+		// Converts samples [first, first+out.size()) into `out`, clipped to
+		// the end of the capture. Returns samples written.
+		static_assert(is_complex<T>::value, "Captures hold complex samples");
+		using scalar = typename sample_traits<T>::scalar;
+
+		if (first >= num_samples()) {
+			return 0;
+		}
+		std::size_t n = std::min(out.size(), num_samples() - first);
+		std::size_t bps = bytes_per_sample(fmt);
+		std::span<const unsigned char> src(file.data() + first*bps, n*bps);
+
+		switch (fmt) {
+		case SampleFormat::CU8:
+			convert_samples<T>(src, out.first(n));
+			break;
+
+		case SampleFormat::CS8: {
+			scalar* dst = reinterpret_cast<scalar*>(out.data());
+			for (std::size_t k = 0; k < 2*n; k++) {
+				dst[k] = static_cast<scalar>(static_cast<std::int8_t>(src[k]) / 128.0);
+			}
+			break;
+		}
+
+		case SampleFormat::CF32: {
+			const float* f = reinterpret_cast<const float*>(src.data());
+			scalar* dst = reinterpret_cast<scalar*>(out.data());
+			std::copy(f, f + 2*n, dst);
+			break;
+		}
+		}
+
+		return n;
+	}
+
+	template <typename Fn>
+	void for_each_chunk(Fn fn) {
+		// Calls `fn(chunk_index, span<const complex<float>>)` for every chunk
+		for (std::size_t i = 0; i < num_chunks(); i++) {
+			fn(i, chunk(i));
+		}
+	}
+
+private:
+	MappedFile file;
+	SampleFormat fmt;
+	std::size_t chunk_samples;
+	std::vector<complex> scratch;
+};
+
+} // namespace rtlsdr
+
+#endif
@@ -2,11 +2,105 @@
 #define CONSTANTS_HPP
 
 #include <cstdlib>
+#include <string>
+#include <stdexcept>
 
-const std::size_t NSAMPS = 512; // Samples per PSD periodogram
+const double SAMPLE_RATE = 2.4e6;
+
+// Welch averaging per sweep step: NSEGMENTS periodograms, each sharing
+// SEG_OVERLAP of its samples with the next
+const std::size_t NSEGMENTS = 8;
+const double SEG_OVERLAP = 0.5;
 
-const std::size_t NINPUTS = NSAMPS/2;
-const std::size_t NOUTPUTS = 5;
 const std::size_t NLAYERS = 16;
 
+// Spectrogram mode: display frames the spectrogram spans (each STFT
+// frame hops half a PSD on from the last, so this sets how many are
+// kept), and bytes per read of the continuous capture (a multiple of
+// 512, the USB transfer size)
+const std::size_t STFT_DISPLAY_FRAMES = 4;
+const std::size_t STREAM_READ = 16384;
+
+// Raster timing of the display the client shows images on (VESA
+// 1024x768 at 60 Hz): pixel clock, and pixels per line and lines per
+// frame including blanking
+const double PIXEL_CLOCK = 65e6;
+const std::size_t X_TOTAL = 1344;
+const std::size_t Y_TOTAL = 806;
+
+// Harmonic mode: frame rate sidebands tracked on each side of every line
+// harmonic, and how many coherent windows of HARM_WINDOW samples (20 Hz
+// resolution) are averaged
+const std::size_t HARM_SIDEBANDS = 2;
+const std::size_t HARM_WINDOW = 120000;
+const std::size_t HARM_WINDOWS = 4;
+
+// Harmonic mode: the line rate the harmonics are placed at is measured
+// first, on a Welch PSD of HARM_EST_SEGMENTS overlapped HARM_EST_NFFT
+// point segments (37 Hz bins, 68 ms of capture)
+const std::size_t HARM_EST_NFFT = 65536;
+const std::size_t HARM_EST_SEGMENTS = 4;
+
+// Raster reconstruction: columns of the rebuilt image across a whole
+// line (blanking included; the ADC resolves about 50 samples per line,
+// eight sub-sample phases each), one row per line
+const std::size_t RASTER_COLS = X_TOTAL/4;
+
+// Raster reconstruction: frames of the capture held back to measure the
+// display's actual frame period before folding (see
+// rtlsdr::estimate_frame_period)
+const std::size_t RASTER_EST_FRAMES = 16;
+
+// What the MLP is fed: "sweep" sums the sweep's step PSDs onto the same
+// bins, "pano" stitches them into one wideband spectrum, "stft" takes a
+// spectrogram of a continuous capture, "harm" measures only the display's
+// line/frame rate harmonics in it, and "raster" doesn't train at all, it
+// rebuilds the displayed image from the capture
+enum class FeatureMode {
+	Sweep,
+	Panorama,
+	Spectrogram,
+	Harmonic,
+	Raster
+};
+
+inline const char* mode_name(FeatureMode mode) {
+	switch (mode) {
+		case FeatureMode::Sweep: return "sweep";
+		case FeatureMode::Panorama: return "pano";
+		case FeatureMode::Spectrogram: return "stft";
+		case FeatureMode::Harmonic: return "harm";
+		case FeatureMode::Raster: return "raster";
+	}
+	return "";
+}
+
+inline FeatureMode parse_mode(const std::string& name) {
+	// The empty string is the default sweep
+	for (auto mode: {FeatureMode::Sweep, FeatureMode::Panorama, FeatureMode::Spectrogram,
+		FeatureMode::Harmonic, FeatureMode::Raster}) {
+		if (name == mode_name(mode)) {
+			return mode;
+		}
+	}
+	if (name.empty()) {
+		return FeatureMode::Sweep;
+	}
+
+	throw std::invalid_argument("Unknown mode \"" + name + "\"");
+}
+
+// PSD and model sizes, chosen at startup. Sizes from 64 to 8192 points
+// run FFT code compiled for that size (rtlsdr::has_fixed_kernels).
+struct SrvConfig {
+	FeatureMode mode = FeatureMode::Sweep;
+	std::size_t nsamps = 512; // Samples per PSD periodogram, a power of two
+	std::size_t ninputs = 0;  // MLP input width; 0 for one per PSD bin (nsamps/2)
+	std::size_t noutputs = 5; // Images the MLP tells apart
+	std::size_t stft_rows = 8; // Spectrogram mode: time slices the inputs are split into
+
+	std::size_t bins() const { return nsamps/2; }
+	std::size_t inputs() const { return ninputs ? ninputs : bins(); }
+};
+
 #endif
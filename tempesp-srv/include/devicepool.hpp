@@ -0,0 +1,302 @@
+#ifndef RTLSDRPP_DEVICEPOOL_HPP
+#define RTLSDRPP_DEVICEPOOL_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <utility>
+#include <exception>
+#include <stdexcept>
+#include <span>
+#include <cstdint>
+
+#include "rtlsdrpp.hpp"
+#include "sources.hpp"
+#include "sweep.hpp"
+
+namespace rtlsdr {
+
+class DevicePool {
+	// Runs one frequency sweep across several backends at once
+	//
+	// The step list is cut into contiguous slices, one per device, and
+	// every device walks its slice on its own thread. With N dongles a
+	// sweep takes roughly 1/N of the time.
+	//
+	// Notes:
+	//	Each device's slice runs through a SweepScheduler, so retunes are
+	//	pipelined and settle samples discarded the same way as on a single
+	//	device.
+	//
+	//	Capture and the step callback already overlap on each device: the
+	//	callback for step k runs while step k+1 is being read. How far
+	//	capture may run ahead is `set_depth()`.
+	//
+	//	The step callback runs concurrently on every device's thread. It is
+	//	given the device index so it can keep per-device state (scratch
+	//	buffers, partial spectra) without locking; merging the partials in
+	//	device order afterwards keeps the result deterministic.
+	//
+	//	Device threads are started by the first multi-device sweep and
+	//	parked between sweeps, and the callback is passed by reference, so
+	//	a sweep creates no threads and allocates nothing.
+	//
+public:
+	DevicePool() = default;
+
+	DevicePool(std::vector<std::unique_ptr<SdrBackend>> backends): devs(std::move(backends)) {}
+
+	DevicePool(const std::vector<std::string>& serials, const TunerConfig& cfg={}) {
+		for (const auto& serial: serials) {
+			devs.emplace_back(std::make_unique<RtlSdr>(0, false, serial, cfg));
+		}
+	}
+
+	static DevicePool open_all(const TunerConfig& cfg={}) {
+		// Opens every attached dongle by index. Unlike opening by serial
+		// this works even if they all still have the default serial.
+		std::vector<std::unique_ptr<SdrBackend>> backends;
+		for (std::uint32_t i = 0; i < rtlsdr_get_device_count(); i++) {
+			backends.emplace_back(std::make_unique<RtlSdr>(i, false, "", cfg));
+		}
+
+		return DevicePool(std::move(backends));
+	}
+
+	static DevicePool from_spec(const std::string& spec, const TunerConfig& cfg={}) {
+		// Semicolon separated list of `open_backend()` specs, e.g.
+		// "rtlsdr:00000001;rtlsdr:00000002". An empty spec opens one dongle.
+		// Every device is opened with `cfg`.
+		std::vector<std::unique_ptr<SdrBackend>> backends;
+
+		std::size_t start = 0;
+		do {
+			std::size_t end = spec.find(';', start);
+			if (end == std::string::npos) {
+				end = spec.size();
+			}
+
+			backends.emplace_back(open_backend(spec.substr(start, end - start), cfg));
+			start = end + 1;
+		} while (start < spec.size());
+
+		return DevicePool(std::move(backends));
+	}
+
+	std::size_t size() const { return devs.size(); }
+	SdrBackend& operator[](std::size_t i) { return *devs.at(i); }
+
+	void add(std::unique_ptr<SdrBackend> backend) {
+		crew.reset(); // sized for the old device count
+		devs.emplace_back(std::move(backend));
+	}
+
+	void set_depth(std::size_t depth) {
+		// Blocks in flight per device, the one its callback is working on
+		// included; 2 is double buffering. Below 2 there'd be no overlap.
+		if (depth < 2) {
+			throw std::invalid_argument("Pipeline depth must be at least 2, got " + std::to_string(depth));
+		}
+		pipeline_depth = depth;
+	}
+
+	SweepTiming timing(std::size_t dev) const {
+		// Timing of device `dev`'s part of the last sweep
+		if (dev >= scheds.size() || !scheds[dev]) {
+			return {};
+		}
+		return scheds[dev]->timing();
+	}
+
+	template <typename Fn>
+	void for_each(Fn fn) {
+		// Applies the same configuration to every device
+		for (auto& dev: devs) {
+			fn(*dev);
+		}
+	}
+
+	std::pair<std::size_t, std::size_t> slice(std::size_t dev, std::size_t nsteps) const {
+		// Step range [first, last) that device `dev` covers
+		return {dev*nsteps/devs.size(), (dev+1)*nsteps/devs.size()};
+	}
+
+	template <typename Fn>
+	void sweep(const std::vector<std::uint32_t>& freqs, std::size_t num_bytes, const Fn& on_step,
+		std::size_t settle_bytes=DEFAULT_SETTLE_BYTES) {
+		// Tunes to every frequency in `freqs`, reads `num_bytes` and hands
+		// them to `on_step(dev, const SweepBlock&)`. Rethrows the first
+		// error any device hit.
+		if (devs.empty()) {
+			throw std::logic_error("DevicePool::sweep on an empty pool");
+		}
+
+		if (scheds.size() != devs.size()) {
+			scheds.resize(devs.size());
+		}
+
+		StepRef step{&on_step, [](const void* fn, std::size_t dev, const SweepBlock& blk) {
+			(*static_cast<const Fn*>(fn))(dev, blk);
+		}};
+
+		if (devs.size() == 1) {
+			sweep_slice(0, freqs, num_bytes, step, settle_bytes);
+			return;
+		}
+
+		if (!crew) {
+			crew = std::make_unique<Crew>(devs.size());
+		}
+		crew->run({this, &freqs, num_bytes, step, settle_bytes});
+	}
+
+private:
+	struct StepRef {
+		// Non-owning handle on the caller's step callback
+		const void* fn;
+		void (*call)(const void* fn, std::size_t dev, const SweepBlock& blk);
+
+		void operator()(std::size_t dev, const SweepBlock& blk) const { call(fn, dev, blk); }
+	};
+
+	struct Job {
+		DevicePool* pool;
+		const std::vector<std::uint32_t>* freqs;
+		std::size_t num_bytes;
+		StepRef on_step;
+		std::size_t settle_bytes;
+	};
+
+	class Crew {
+		// One thread per device, parked between sweeps. Only touches the
+		// pool through the Job it's handed, so the pool can still move.
+	public:
+		Crew(std::size_t n): errors(n) {
+			for (std::size_t d = 0; d < n; d++) {
+				threads.emplace_back([this, d]() { work(d); });
+			}
+		}
+
+		~Crew() {
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				stopping = true;
+			}
+			start.notify_all();
+
+			for (auto& t: threads) {
+				t.join();
+			}
+		}
+
+		void run(const Job& j) {
+			// Hands every device its slice and waits for all of them
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				job = j;
+				std::fill(std::begin(errors), std::end(errors), nullptr);
+				busy = threads.size();
+				generation++;
+				start.notify_all();
+
+				done.wait(lock, [this]() { return busy == 0; });
+			}
+
+			for (auto& e: errors) {
+				if (e) {
+					std::rethrow_exception(e);
+				}
+			}
+		}
+
+	private:
+		void work(std::size_t d) {
+			std::uint64_t seen = 0;
+			std::unique_lock<std::mutex> lock(mtx);
+
+			while (true) {
+				start.wait(lock, [&]() { return stopping || generation != seen; });
+				if (stopping) {
+					return;
+				}
+				seen = generation;
+				Job j = job;
+
+				lock.unlock();
+				try {
+					j.pool->sweep_slice(d, *j.freqs, j.num_bytes, j.on_step, j.settle_bytes);
+				}
+				catch (...) {
+					errors[d] = std::current_exception();
+				}
+				lock.lock();
+
+				if (--busy == 0) {
+					done.notify_all();
+				}
+			}
+		}
+
+		std::mutex mtx;
+		std::condition_variable start, done;
+		std::vector<std::thread> threads;
+		std::vector<std::exception_ptr> errors; // one per device, from the last sweep
+		Job job{};
+		std::uint64_t generation = 0;
+		std::size_t busy = 0;
+		bool stopping = false;
+	};
+
+	void sweep_slice(std::size_t d, const std::vector<std::uint32_t>& freqs, std::size_t num_bytes,
+		StepRef on_step, std::size_t settle_bytes) {
+
+		auto [first, last] = slice(d, freqs.size());
+		if (first == last) {
+			return;
+		}
+
+		// Schedulers are kept between sweeps so their buffers are reused
+		auto& sched = scheds[d];
+		if (!sched || sched->block_bytes() != num_bytes || sched->settle() != settle_bytes ||
+			sched->depth() != pipeline_depth) {
+
+			sched = std::make_unique<SweepScheduler>(*devs[d], std::vector<std::uint32_t>(), num_bytes,
+				settle_bytes, pipeline_depth);
+		}
+		sched->set_plan(std::begin(freqs)+first, std::begin(freqs)+last);
+
+		sched->run([&](SweepBlock blk) {
+			blk.step += first; // report global step index
+			on_step(d, blk);
+		});
+	}
+
+	std::vector<std::unique_ptr<SdrBackend>> devs;
+	std::vector<std::unique_ptr<SweepScheduler>> scheds; // one per device, built on first sweep
+	std::size_t pipeline_depth = 2;
+	std::unique_ptr<Crew> crew; // declared last so its threads stop first
+};
+
+} // namespace rtlsdr
+
+#endif
@@ -0,0 +1,460 @@
+#ifndef RTLSDRPP_GOERTZEL_HPP
+#define RTLSDRPP_GOERTZEL_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <span>
+#include <complex>
+#include <algorithm>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <cstdint>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "fft.hpp"
+
+namespace rtlsdr {
+
+const std::size_t DEFAULT_GOERTZEL_CHUNK = 1024;
+const double DEFAULT_PERIOD_TOLERANCE = 0.005; // VESA allows the pixel clock 0.5% either way
+
+struct DisplayTiming {
+	// Raster timing of a display, in the terms of notes.md
+	double pixel_clock;  // f_p, Hz
+	std::size_t x_total; // x_t, pixels per line including blanking
+	std::size_t y_total; // y_t, lines per frame including blanking
+
+	double h_freq() const { return pixel_clock / x_total; }          // f_h
+	double v_freq() const { return pixel_clock / (x_total*y_total); } // f_v, one frame per x_t*y_t pixels
+};
+
+inline std::vector<double> display_harmonics(const DisplayTiming& t, double f_lo, double f_hi, std::size_t v_sidebands=2) {
+	// Frequencies in [f_lo, f_hi] where a raster scanned with timing `t`
+	// puts its energy: every harmonic k*f_h of the line rate, flanked by
+	// the first `v_sidebands` frame rate lines k*f_h +- m*f_v
+	//
+	// Returns:
+	//	vector: Ascending frequencies, Hz
+	//
+	double fh = t.h_freq(), fv = t.v_freq();
+	double reach = v_sidebands * fv;
+
+	std::vector<double> freqs;
+	long k0 = std::max(0L, static_cast<long>(std::floor((f_lo - reach) / fh)));
+	long k1 = static_cast<long>(std::ceil((f_hi + reach) / fh));
+
+	for (long k = k0; k <= k1; k++) {
+		for (long m = -static_cast<long>(v_sidebands); m <= static_cast<long>(v_sidebands); m++) {
+			double f = k*fh + m*fv;
+			if (f > 0 && f >= f_lo && f <= f_hi) {
+				freqs.push_back(f);
+			}
+		}
+	}
+
+	std::sort(std::begin(freqs), std::end(freqs));
+	return freqs;
+}
+
+inline double estimate_line_rate(std::span<const float> psd, double bin_hz, double nominal,
+	double f0=0, double tolerance=DEFAULT_PERIOD_TOLERANCE) {
+	// Measures a display's actual line rate f_h from a power spectrum of
+	// its emanations
+	//
+	// The line harmonics k*f_h stand out as a comb whose spacing is the
+	// line rate. Comb spacings within `tolerance` of `nominal` are tried
+	// (in steps that move the highest harmonic a quarter bin) and scored
+	// by the mean log power under their teeth, so a strong unrelated
+	// carrier sways one tooth, not the score. Each tooth of the best comb
+	// is then interpolated to its own peak, and f_h is the least squares
+	// fit of those peaks to k*f_h. The high harmonics pin it down, to a
+	// small fraction of a bin.
+	//
+	// Arguments:
+	//	psd: Power spectrum, bin k at f0 + k*bin_hz; resolution fine
+	//		enough to separate the harmonics (tens of Hz)
+	//	bin_hz: Bin width
+	//	nominal: Expected line rate, Hz
+	//	f0: Frequency of bin 0, e.g. the tune frequency when direct
+	//		sampling
+	//	tolerance: Fraction of `nominal` searched either side
+	//
+	// Returns:
+	//	double: Line rate, Hz
+	//
+	if (bin_hz <= 0 || nominal <= 0 || f0 < 0 || tolerance < 0 || tolerance >= 0.5) {
+		throw std::invalid_argument("Line rate estimate needs a positive bin width and nominal rate, "
+			"and a tolerance in [0, 0.5)");
+	}
+
+	// Harmonics that stay in the spectrum, clear of DC and the top bin,
+	// for every spacing tried
+	double lo = nominal * (1 - tolerance), hi = nominal * (1 + tolerance);
+	long k0 = std::max(1L, static_cast<long>(std::ceil((f0 + 2*bin_hz) / lo)));
+	long k1 = static_cast<long>(std::floor((f0 + (double(psd.size()) - 3) * bin_hz) / hi));
+	if (psd.size() < 8 || k1 < k0) {
+		throw std::length_error("Spectrum from " + std::to_string(f0) + " Hz holds no line harmonic");
+	}
+
+	std::vector<double> logp(psd.size());
+	for (std::size_t i = 0; i < psd.size(); i++) {
+		logp[i] = std::log(std::max(double(psd[i]), 1e-30));
+	}
+
+	auto bin_of = [f0, bin_hz](double f) { return (f - f0) / bin_hz; };
+	auto comb = [&](double fh) {
+		double score = 0;
+		for (long k = k0; k <= k1; k++) {
+			double b = bin_of(k*fh);
+			std::size_t i = b;
+			score += logp[i] + (b - i) * (logp[i + 1] - logp[i]);
+		}
+		return score;
+	};
+
+	double step = bin_hz / (4.0 * k1);
+	std::size_t nsteps = std::ceil((hi - lo) / step);
+
+	double coarse = lo, best = comb(lo);
+	for (std::size_t j = 1; j <= nsteps; j++) {
+		double score = comb(lo + j*step);
+		if (score > best) {
+			coarse = lo + j*step;
+			best = score;
+		}
+	}
+
+	// Each tooth's peak: the largest bin within a bin of where the comb
+	// put it, interpolated as a parabola in log power
+	double num = 0, den = 0;
+	for (long k = k0; k <= k1; k++) {
+		double b = bin_of(k*coarse);
+		std::size_t i = std::lround(b);
+		for (std::size_t j: {i - 1, i + 1}) {
+			if (logp[j] > logp[i]) {
+				i = j;
+			}
+		}
+		if (std::abs(double(i) - b) > 1) {
+			continue;
+		}
+
+		double a = logp[i - 1], c = logp[i], d = logp[i + 1];
+		double curv = a - 2*c + d;
+		double off = curv < 0 ? std::clamp(0.5 * (a - d) / curv, -0.5, 0.5) : 0.0;
+
+		num += k * (f0 + (i + off) * bin_hz);
+		den += double(k) * k;
+	}
+
+	return den > 0 ? num / den : coarse;
+}
+
+namespace detail {
+
+#if defined(__AVX2__)
+inline __m256 madd(__m256 a, __m256 b, __m256 c) {
+	// a*b + c; fused where the target has FMA, which AVX2 doesn't imply
+#if defined(__FMA__)
+	return _mm256_fmadd_ps(a, b, c);
+#else
+	return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+#endif
+
+inline std::size_t goertzel_simd(const float* x, std::size_t n, const float* c, float* s1, float* s2, std::size_t nf) {
+	// Runs n samples through filters [0, nf), vectorized across filters
+	// with each group's state kept in registers for the whole run. Two
+	// groups go at once so their recurrences overlap. Returns how many
+	// filters it handled; the caller does the rest.
+	std::size_t k = 0;
+
+#if defined(__AVX2__)
+	for (; k + 16 <= nf; k += 16) {
+		__m256 ca = _mm256_loadu_ps(c + k), cb = _mm256_loadu_ps(c + k + 8);
+		__m256 a1 = _mm256_loadu_ps(s1 + k), a2 = _mm256_loadu_ps(s2 + k);
+		__m256 b1 = _mm256_loadu_ps(s1 + k + 8), b2 = _mm256_loadu_ps(s2 + k + 8);
+
+		for (std::size_t i = 0; i < n; i++) {
+			__m256 xv = _mm256_set1_ps(x[i]);
+			__m256 a0 = madd(ca, a1, _mm256_sub_ps(xv, a2));
+			__m256 b0 = madd(cb, b1, _mm256_sub_ps(xv, b2));
+			a2 = a1; a1 = a0;
+			b2 = b1; b1 = b0;
+		}
+
+		_mm256_storeu_ps(s1 + k, a1); _mm256_storeu_ps(s2 + k, a2);
+		_mm256_storeu_ps(s1 + k + 8, b1); _mm256_storeu_ps(s2 + k + 8, b2);
+	}
+
+	for (; k + 8 <= nf; k += 8) {
+		__m256 ca = _mm256_loadu_ps(c + k);
+		__m256 a1 = _mm256_loadu_ps(s1 + k), a2 = _mm256_loadu_ps(s2 + k);
+
+		for (std::size_t i = 0; i < n; i++) {
+			__m256 a0 = madd(ca, a1, _mm256_sub_ps(_mm256_set1_ps(x[i]), a2));
+			a2 = a1; a1 = a0;
+		}
+
+		_mm256_storeu_ps(s1 + k, a1); _mm256_storeu_ps(s2 + k, a2);
+	}
+#elif defined(__ARM_NEON)
+	for (; k + 8 <= nf; k += 8) {
+		float32x4_t ca = vld1q_f32(c + k), cb = vld1q_f32(c + k + 4);
+		float32x4_t a1 = vld1q_f32(s1 + k), a2 = vld1q_f32(s2 + k);
+		float32x4_t b1 = vld1q_f32(s1 + k + 4), b2 = vld1q_f32(s2 + k + 4);
+
+		for (std::size_t i = 0; i < n; i++) {
+			float32x4_t xv = vdupq_n_f32(x[i]);
+			float32x4_t a0 = vmlaq_f32(vsubq_f32(xv, a2), ca, a1);
+			float32x4_t b0 = vmlaq_f32(vsubq_f32(xv, b2), cb, b1);
+			a2 = a1; a1 = a0;
+			b2 = b1; b1 = b0;
+		}
+
+		vst1q_f32(s1 + k, a1); vst1q_f32(s2 + k, a2);
+		vst1q_f32(s1 + k + 4, b1); vst1q_f32(s2 + k + 4, b2);
+	}
+
+	for (; k + 4 <= nf; k += 4) {
+		float32x4_t ca = vld1q_f32(c + k);
+		float32x4_t a1 = vld1q_f32(s1 + k), a2 = vld1q_f32(s2 + k);
+
+		for (std::size_t i = 0; i < n; i++) {
+			float32x4_t a0 = vmlaq_f32(vsubq_f32(vdupq_n_f32(x[i]), a2), ca, a1);
+			a2 = a1; a1 = a0;
+		}
+
+		vst1q_f32(s1 + k, a1); vst1q_f32(s2 + k, a2);
+	}
+#else
+	(void)x;
+	(void)n;
+	(void)c;
+	(void)s1;
+	(void)s2;
+	(void)nf;
+#endif
+
+	return k;
+}
+
+} // namespace detail
+
+class GoertzelBank {
+	// DFT power of real samples at an arbitrary list of frequencies
+	//
+	// Each frequency gets a Goertzel filter, one multiply and two adds per
+	// sample, so tracking a few dozen frequencies costs a fraction of an
+	// FFT fine enough to resolve them, and the frequencies don't have to
+	// sit on any bin grid. Samples stream in blocks of any size.
+	//
+	// Every `window` samples the bank yields |X(f)|^2 of that window for
+	// each frequency (resolution sample_rate/window), and `powers()`
+	// averages those over the windows seen so far. Long windows are
+	// built from chunks: the float filters restart every `chunk` samples,
+	// which keeps their rounding error small, and each chunk's result is
+	// phase-rotated into a double precision sum for the window, so the
+	// result is the same as one coherent DFT over the whole window.
+	//
+	// Arguments:
+	//	freqs: Frequencies to track, Hz, in [0, sample_rate/2]
+	//	sample_rate: Hz
+	//	window: Samples per coherent measurement
+	//	chunk: Samples per float filter run
+	//
+public:
+	GoertzelBank(std::span<const double> freqs, double sample_rate_, std::size_t window_,
+		std::size_t chunk_=DEFAULT_GOERTZEL_CHUNK):
+		sample_rate(sample_rate_), win(window_), chunk(chunk_) {
+
+		if (sample_rate <= 0 || win == 0 || chunk == 0) {
+			throw std::invalid_argument("GoertzelBank needs a positive sample rate, window and chunk");
+		}
+
+		set_freqs(freqs);
+	}
+
+	void set_freqs(std::span<const double> freqs) {
+		// Retunes the bank; clears everything measured so far
+		for (double f: freqs) {
+			if (f < 0 || f > sample_rate/2) {
+				throw std::invalid_argument("GoertzelBank frequency " + std::to_string(f) +
+					" Hz is outside 0.." + std::to_string(sample_rate/2));
+			}
+		}
+
+		nf = freqs.size();
+		std::size_t padded = (nf + 7) / 8 * 8; // whole SIMD groups; spare filters have c = 0
+
+		omega.resize(nf);
+		rot.resize(nf);
+		coef.assign(padded, 0);
+		for (std::size_t k = 0; k < nf; k++) {
+			omega[k] = 2*std::numbers::pi * freqs[k] / sample_rate;
+			rot[k] = std::polar(1.0, omega[k]);
+			coef[k] = 2*std::cos(omega[k]);
+		}
+
+		s1.resize(padded);
+		s2.resize(padded);
+		acc.resize(nf);
+		pw.resize(nf);
+		clear();
+	}
+
+	void clear() {
+		// Drops the window in progress and every finished one
+		drop_window();
+		std::fill(std::begin(pw), std::end(pw), 0);
+		nwin = 0;
+	}
+
+	void drop_window() {
+		// Drops the window in progress but keeps the finished ones, e.g.
+		// after a gap in the stream, which a coherent window can't span
+		std::fill(std::begin(s1), std::end(s1), 0);
+		std::fill(std::begin(s2), std::end(s2), 0);
+		std::fill(std::begin(acc), std::end(acc), 0);
+		in_chunk = 0;
+		in_window = 0;
+	}
+
+	std::size_t size() const { return nf; }
+	std::size_t window() const { return win; }
+	double resolution() const { return sample_rate / win; }
+	std::uint64_t windows() const { return nwin; } // finished since clear()
+
+	std::size_t push(std::span<const float> x) {
+		// Streams samples through every filter
+		//
+		// Returns:
+		//	size_t: Windows finished by this call
+		//
+		std::size_t made = 0;
+		std::size_t i = 0;
+
+		while (i < x.size()) {
+			std::size_t take = std::min({x.size() - i, chunk - in_chunk, win - in_window});
+
+			run(x.data() + i, take);
+			i += take;
+			in_chunk += take;
+			in_window += take;
+
+			if (in_chunk == chunk || in_window == win) {
+				end_chunk();
+			}
+			if (in_window == win) {
+				end_window();
+				made++;
+			}
+		}
+
+		return made;
+	}
+
+	void powers(std::span<float> out) const {
+		// Mean |X(f)|^2 / window^2 over the finished windows: a tone of
+		// amplitude A at f reads A^2/4. Zeros before the first window.
+		if (out.size() < nf) {
+			throw std::length_error("GoertzelBank output holds " + std::to_string(out.size()) +
+				" values, need " + std::to_string(nf));
+		}
+
+		double scale = nwin ? 1.0 / (double(win)*win*nwin) : 0.0;
+		for (std::size_t k = 0; k < nf; k++) {
+			out[k] = pw[k] * scale;
+		}
+	}
+
+private:
+	void run(const float* x, std::size_t n) {
+		std::size_t k = detail::goertzel_simd(x, n, coef.data(), s1.data(), s2.data(), coef.size());
+
+		// Without SIMD, eight filters per pass still lets the compiler
+		// vectorize across them; coef.size() is a whole number of groups
+		for (; k < coef.size(); k += 8) {
+			float c[8], a1[8], a2[8];
+			std::copy_n(coef.data() + k, 8, c);
+			std::copy_n(s1.data() + k, 8, a1);
+			std::copy_n(s2.data() + k, 8, a2);
+
+			for (std::size_t i = 0; i < n; i++) {
+				for (std::size_t j = 0; j < 8; j++) {
+					float a0 = x[i] + c[j]*a1[j] - a2[j];
+					a2[j] = a1[j];
+					a1[j] = a0;
+				}
+			}
+
+			std::copy_n(a1, 8, s1.data() + k);
+			std::copy_n(a2, 8, s2.data() + k);
+		}
+	}
+
+	void end_chunk() {
+		// After a run ending at window sample n-1, the chunk's share of
+		// the window's DFT is e^(-i w n) (e^(i w) s1 - s2)
+		for (std::size_t k = 0; k < nf; k++) {
+			std::complex<double> y = rot[k] * double(s1[k]) - double(s2[k]);
+			acc[k] += std::polar(1.0, -omega[k] * in_window) * y;
+		}
+
+		std::fill(std::begin(s1), std::end(s1), 0);
+		std::fill(std::begin(s2), std::end(s2), 0);
+		in_chunk = 0;
+	}
+
+	void end_window() {
+		for (std::size_t k = 0; k < nf; k++) {
+			pw[k] += std::norm(acc[k]);
+			acc[k] = 0;
+		}
+
+		in_window = 0;
+		nwin++;
+	}
+
+	double sample_rate;
+	std::size_t win;
+	std::size_t chunk;
+	std::size_t nf = 0;
+
+	std::vector<double> omega;
+	std::vector<std::complex<double>> rot; // e^(i w)
+	aligned_vector<float> coef, s1, s2;   // 2 cos w and filter state, padded
+	std::vector<std::complex<double>> acc; // window in progress
+	std::vector<double> pw;                // sum of finished windows' |X|^2
+
+	std::size_t in_chunk = 0;
+	std::size_t in_window = 0;
+	std::uint64_t nwin = 0;
+};
+
+} // namespace rtlsdr
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef RTLSDRPP_PSD_HPP
+#define RTLSDRPP_PSD_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <span>
+#include <complex>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+
+#include "fft.hpp"
+#include "window.hpp"
+
+namespace rtlsdr {
+
+namespace detail {
+
+template <typename T>
+struct PowerAcc {
+	// psd[k] += scale * |X[k]|^2 for the first n/2 bins of an n point
+	// transform, X interleaved re/im
+	template <std::size_t N>
+	struct K {
+		static void run(const T* __restrict x, T* __restrict psd, T scale, std::size_t n_) {
+			const std::size_t bins = (N ? N : n_) / 2;
+			for (std::size_t k = 0; k < bins; k++) {
+				psd[k] += scale * (x[2*k]*x[2*k] + x[2*k + 1]*x[2*k + 1]);
+			}
+		}
+	};
+};
+
+} // namespace detail
+
+template <typename T=float>
+class WelchPsd {
+	// Welch's averaged, overlapped periodogram of real samples
+	//
+	// One block of `block_size()` samples is cut into `segments` windows
+	// of `nfft` samples, each starting `hop()` after the last. Averaging K
+	// periodograms cuts the variance of each bin by up to K, and with
+	// overlap the segments reuse samples instead of needing K times the
+	// capture.
+	//
+	// The segment FFTs run as a batch: every segment is windowed into one
+	// staging buffer, then transformed back to back and reduced. The plan,
+	// twiddles and window stay hot in cache for the whole batch. The
+	// window, FFT and power loops are the copies built for `nfft` when it
+	// has them (see has_fixed_kernels), picked once here.
+	//
+	// Arguments:
+	//	nfft: Segment length, a power of two
+	//	segments: Periodograms averaged per block
+	//	overlap: Fraction of each segment shared with the next, 0 <= overlap < 1
+	//		(0.5 for Hann-like windows, up to 0.75 for narrow ones like
+	//		Blackman-Harris or flat-top)
+	//	win: Window applied to every segment
+	//
+public:
+	using complex = std::complex<T>;
+
+	WelchPsd(std::size_t nfft_, std::size_t segments_=1, double overlap=0.5, WindowSpec win={}):
+		nfft(nfft_), segments(segments_), fft(nfft_) {
+
+		if (segments == 0) {
+			throw std::invalid_argument("WelchPsd needs at least one segment");
+		}
+		if (overlap < 0 || overlap >= 1) {
+			throw std::invalid_argument("WelchPsd overlap must be in [0, 1)");
+		}
+
+		hop_len = std::max<std::size_t>(1, std::lround(nfft * (1 - overlap)));
+		power = detail::select_kernel<detail::PowerAcc<T>::template K>(nfft);
+
+		stage.resize(segments * nfft);
+		spec.resize(segments * fft.bins());
+
+		set_window(win);
+	}
+
+	void set_window(WindowSpec win) { window = &get_window<T>(win, nfft); }
+
+	const Window<T>& current_window() const { return *window; }
+
+	std::size_t size() const { return nfft; }
+	std::size_t num_segments() const { return segments; }
+	std::size_t hop() const { return hop_len; }
+	std::size_t bins() const { return nfft/2; }
+
+	std::size_t block_size() const {
+		// Samples consumed per `accumulate()`
+		return nfft + (segments - 1) * hop_len;
+	}
+
+	void accumulate(std::span<const T> block, std::span<T> psd) {
+		// Adds the block's averaged periodogram to psd[0..bins()), DC up
+		// to but not including Nyquist. The result is scaled by the
+		// window's power factor, so different windows read alike.
+		if (block.size() < block_size()) {
+			throw std::length_error("WelchPsd block holds " + std::to_string(block.size()) +
+				" samples, need " + std::to_string(block_size()));
+		}
+		if (psd.size() < bins()) {
+			throw std::length_error("WelchPsd output holds " + std::to_string(psd.size()) +
+				" bins, need " + std::to_string(bins()));
+		}
+
+		std::size_t nb = fft.bins();
+
+		for (std::size_t s = 0; s < segments; s++) {
+			window->apply(block.subspan(s*hop_len, nfft), std::span<T>(stage.data() + s*nfft, nfft));
+		}
+
+		for (std::size_t s = 0; s < segments; s++) {
+			fft.forward(std::span<const T>(stage.data() + s*nfft, nfft),
+				std::span<complex>(spec.data() + s*nb, nb));
+		}
+
+		T scale = window->power_scale() / segments;
+		for (std::size_t s = 0; s < segments; s++) {
+			power(reinterpret_cast<const T*>(spec.data() + s*nb), psd.data(), scale, nfft);
+		}
+	}
+
+private:
+	std::size_t nfft;
+	std::size_t segments;
+	std::size_t hop_len;
+
+	RealFft<T> fft;
+	const Window<T>* window;
+
+	aligned_vector<T> stage;      // windowed segments, back to back
+	aligned_vector<complex> spec; // their half spectra
+	void (*power)(const T*, T*, T, std::size_t);
+};
+
+} // namespace rtlsdr
+
+#endif
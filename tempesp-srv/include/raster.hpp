@@ -0,0 +1,408 @@
+#ifndef RTLSDRPP_RASTER_HPP
+#define RTLSDRPP_RASTER_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <cstdint>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "fft.hpp"
+#include "goertzel.hpp"
+
+namespace rtlsdr {
+
+const std::size_t DEFAULT_RASTER_PHASES = 8;
+
+namespace detail {
+
+inline std::size_t raster_add_simd(const unsigned char* in, std::size_t n, std::uint32_t* acc, std::uint32_t* cnt) {
+	// acc[i] += in[i], cnt[i] += 1. Returns how many samples it handled;
+	// the caller finishes the tail.
+	std::size_t i = 0;
+
+#if defined(__AVX2__)
+	const __m256i one = _mm256_set1_epi32(1);
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		__m256i lo = _mm256_cvtepu8_epi32(raw);
+		__m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(raw, 8));
+
+		__m256i* a = reinterpret_cast<__m256i*>(acc + i);
+		__m256i* c = reinterpret_cast<__m256i*>(cnt + i);
+		_mm256_storeu_si256(a,     _mm256_add_epi32(_mm256_loadu_si256(a), lo));
+		_mm256_storeu_si256(a + 1, _mm256_add_epi32(_mm256_loadu_si256(a + 1), hi));
+		_mm256_storeu_si256(c,     _mm256_add_epi32(_mm256_loadu_si256(c), one));
+		_mm256_storeu_si256(c + 1, _mm256_add_epi32(_mm256_loadu_si256(c + 1), one));
+	}
+#elif defined(__ARM_NEON)
+	const uint32x4_t one = vdupq_n_u32(1);
+
+	for (; i + 16 <= n; i += 16) {
+		uint8x16_t raw = vld1q_u8(in + i);
+		uint16x8_t lo16 = vmovl_u8(vget_low_u8(raw));
+		uint16x8_t hi16 = vmovl_u8(vget_high_u8(raw));
+
+		vst1q_u32(acc + i,      vaddw_u16(vld1q_u32(acc + i),      vget_low_u16(lo16)));
+		vst1q_u32(acc + i + 4,  vaddw_u16(vld1q_u32(acc + i + 4),  vget_high_u16(lo16)));
+		vst1q_u32(acc + i + 8,  vaddw_u16(vld1q_u32(acc + i + 8),  vget_low_u16(hi16)));
+		vst1q_u32(acc + i + 12, vaddw_u16(vld1q_u32(acc + i + 12), vget_high_u16(hi16)));
+
+		for (std::size_t k = 0; k < 16; k += 4) {
+			vst1q_u32(cnt + i + k, vaddq_u32(vld1q_u32(cnt + i + k), one));
+		}
+	}
+#else
+	(void)in;
+	(void)n;
+	(void)acc;
+	(void)cnt;
+#endif
+
+	return i;
+}
+
+inline double lag_product(const float* x, std::size_t n, std::size_t lag) {
+	// Mean of x[i]*x[i+lag] over the n-lag pairs. Eight partial sums let
+	// the compiler vectorize without reassociating one long float sum.
+	std::size_t m = n - lag;
+	float part[8] = {};
+
+	std::size_t i = 0;
+	for (; i + 8 <= m; i += 8) {
+		for (std::size_t j = 0; j < 8; j++) {
+			part[j] += x[i + j] * x[i + j + lag];
+		}
+	}
+
+	double sum = 0;
+	for (; i < m; i++) {
+		sum += double(x[i]) * x[i + lag];
+	}
+	for (float p: part) {
+		sum += p;
+	}
+
+	return sum / m;
+}
+
+inline double parabolic_peak(double a, double b, double c) {
+	// Offset in (-1/2, 1/2) of the vertex of the parabola through
+	// (-1, a), (0, b), (1, c), b being the largest
+	double den = a - 2*b + c;
+	return den < 0 ? std::clamp(0.5 * (a - c) / den, -0.5, 0.5) : 0.0;
+}
+
+} // namespace detail
+
+inline double estimate_frame_period(std::span<const unsigned char> bytes, double nominal,
+	double tolerance=DEFAULT_PERIOD_TOLERANCE) {
+	// Measures a display's actual frame period from the raw stream
+	//
+	// The picture repeats every frame, so the stream's autocorrelation
+	// peaks at the true period. Every whole-sample lag within `tolerance`
+	// of `nominal` is tried. The best one is then refined at the largest
+	// multiple of it the capture holds, which divides its error by that
+	// multiple, and the peak there is interpolated between samples.
+	//
+	// Notes:
+	//	A nominal period can be off by hundreds of samples (0.5% of a
+	//	frame), which smears a RasterAverager picture within a few
+	//	frames; the estimate is typically good to a small fraction of a
+	//	sample. It costs a few hundred correlations over the capture, so
+	//	it's meant to be run once per capture, not per block.
+	//
+	// Arguments:
+	//	bytes: Gapless direct sampling stream of at least twice the
+	//		longest period searched; a handful of frames is plenty
+	//	nominal: Expected period, samples
+	//	tolerance: Fraction of `nominal` searched either side
+	//
+	// Returns:
+	//	double: Frame period, samples
+	//
+	if (nominal < 2 || tolerance < 0 || tolerance >= 0.5) {
+		throw std::invalid_argument("Frame period estimate needs a nominal period of at least 2 samples "
+			"and a tolerance in [0, 0.5)");
+	}
+
+	std::size_t lo = std::max<std::size_t>(1, std::floor(nominal * (1 - tolerance)));
+	std::size_t hi = std::ceil(nominal * (1 + tolerance)) + 1;
+	std::size_t n = bytes.size();
+	if (n < 2*hi) {
+		throw std::length_error("Frame period estimate needs " + std::to_string(2*hi) +
+			" samples, got " + std::to_string(n));
+	}
+
+	double mean = 0;
+	for (unsigned char b: bytes) {
+		mean += b;
+	}
+	mean /= n;
+
+	std::vector<float> x(n);
+	for (std::size_t i = 0; i < n; i++) {
+		x[i] = bytes[i] - mean;
+	}
+
+	auto corr = [&x, n](std::size_t lag) { return detail::lag_product(x.data(), n, lag); };
+
+	// Coarse: whole-sample lags, one period apart
+	std::size_t best = lo;
+	double best_r = corr(lo);
+	for (std::size_t lag = lo + 1; lag <= hi; lag++) {
+		double r = corr(lag);
+		if (r > best_r) {
+			best = lag;
+			best_r = r;
+		}
+	}
+
+	// Fine: m periods apart, keeping at least a period of overlap. The
+	// coarse lag is within half a sample of the period, so m of them are
+	// within m/2 samples of m periods.
+	std::size_t m = std::max<std::size_t>(1, (n - best) / (best + 1));
+	std::size_t center = m * best, reach = m/2 + 1;
+
+	std::size_t fine = center;
+	double fine_r = corr(center);
+	for (std::size_t lag = center - reach; lag <= center + reach; lag++) {
+		double r = corr(lag);
+		if (r > fine_r) {
+			fine = lag;
+			fine_r = r;
+		}
+	}
+
+	double off = detail::parabolic_peak(corr(fine - 1), fine_r, corr(fine + 1));
+	return (fine + off) / m;
+}
+
+class RasterAverager {
+	// Rebuilds a display's raster by averaging the sample stream over
+	// many frames (van Eck)
+	//
+	// The beam is at pixel (x, y) of frame n at t = x/f_p + y/f_h + n/f_v
+	// (notes.md), so samples one frame period apart see the same pixel.
+	// Each frame's run of samples is added onto the previous ones and the
+	// noise averages out, leaving the picture's own signal.
+	//
+	// A frame rarely lasts a whole number of samples, so the phase of the
+	// first sample of each frame within the frame drifts by a fraction of
+	// a sample from frame to frame. It's tracked exactly (32.32 fixed
+	// point), and frames are summed into one of `phases` rows by that
+	// sub-sample phase. Interleaving the rows then gives the frame sampled
+	// `phases` times finer than the ADC, so the raster gets sharper as
+	// frames with new phases arrive.
+	//
+	// Samples are the raw ADC bytes of direct sampling, summed as 32 bit
+	// integers (about 16 million frames before they overflow). Each frame
+	// run is a contiguous vector add, SIMD with AVX2 or NEON. All buffers
+	// are sized in `set_timing()`; `push()` never allocates.
+	//
+	// Notes:
+	//	The stream has to be gapless. After a known gap, `skip()` the
+	//	missing samples to keep the phase right. Frame 0 starts at the
+	//	first sample pushed, which is an arbitrary point in the display's
+	//	own frame, so the image comes out rolled; only a shift separates
+	//	it from the screen.
+	//
+	// Arguments:
+	//	timing: Display raster timing
+	//	sample_rate: Hz
+	//	phases: Sub-sample phase bins per sample
+	//
+public:
+	RasterAverager(const DisplayTiming& timing, double sample_rate, std::size_t phases_=DEFAULT_RASTER_PHASES):
+		nphases(phases_) {
+
+		if (nphases == 0) {
+			throw std::invalid_argument("RasterAverager needs at least one phase");
+		}
+
+		set_timing(timing, sample_rate);
+	}
+
+	void set_timing(const DisplayTiming& timing_, double sample_rate) {
+		// Retimes the raster, e.g. with a pixel clock trimmed until the
+		// picture stops rolling; clears everything accumulated
+		if (timing_.pixel_clock <= 0 || timing_.x_total == 0 || timing_.y_total == 0 || sample_rate <= 0) {
+			throw std::invalid_argument("RasterAverager needs a positive pixel clock, raster size and sample rate");
+		}
+
+		timing = timing_;
+		period = sample_rate * timing.x_total * timing.y_total / timing.pixel_clock;
+		if (period < 2) {
+			throw std::invalid_argument("RasterAverager frame is under two samples long");
+		}
+
+		period_fx = static_cast<std::uint64_t>(std::llround(std::ldexp(period, 32)));
+		len = (period_fx + ONE - 1) >> 32;
+
+		acc.resize(nphases * len);
+		cnt.resize(nphases * len);
+		clear();
+	}
+
+	void clear() {
+		// Drops every frame; the next sample pushed starts frame 0
+		std::fill(std::begin(acc), std::end(acc), 0);
+		std::fill(std::begin(cnt), std::end(cnt), 0);
+
+		delta = 0;
+		start_frame();
+		nframes = 0;
+	}
+
+	double frame_period() const { return period; } // samples
+	std::size_t phases() const { return nphases; }
+	std::uint64_t frames() const { return nframes; } // finished since clear()
+
+	std::size_t push(std::span<const unsigned char> bytes) {
+		// Folds samples into the raster
+		//
+		// Returns:
+		//	size_t: Frames finished by this call
+		//
+		return advance(bytes.data(), bytes.size());
+	}
+
+	std::size_t skip(std::size_t n) {
+		// Accounts for n samples lost from the stream
+		return advance(nullptr, n);
+	}
+
+	void image(std::span<float> out, std::size_t cols, std::size_t rows) const {
+		// Renders the whole raster, blanking included, as rows x cols
+		// (one row per line when rows == y_t), row-major. Each cell is the
+		// mean of the samples whose time falls in it, scaled like
+		// convert_samples (-1..1). Cells no sample has reached yet read
+		// as the mean of the rest.
+		if (cols == 0 || rows == 0 || out.size() < rows*cols) {
+			throw std::length_error("RasterAverager image needs a nonempty grid of at most " +
+				std::to_string(out.size()) + " values");
+		}
+
+		std::uint64_t all_sum = 0, all_cnt = 0;
+		for (std::size_t q = 0; q < acc.size(); q++) {
+			all_sum += acc[q];
+			all_cnt += cnt[q];
+		}
+		double fill = all_cnt ? double(all_sum) / all_cnt : 127.5;
+
+		// Frame time in sub-sample steps: sample j of phase row k covers
+		// [j + k/phases, j + (k+1)/phases)
+		double steps_per_pixel = period * nphases / (double(timing.x_total) * timing.y_total);
+		std::size_t nsteps = nphases * len;
+
+		for (std::size_t r = 0; r < rows; r++) {
+			double line = std::floor((r + 0.5) * timing.y_total / rows);
+
+			for (std::size_t c = 0; c < cols; c++) {
+				double x0 = double(c) * timing.x_total / cols, x1 = double(c + 1) * timing.x_total / cols;
+				std::size_t qa = std::min<std::size_t>((line*timing.x_total + x0) * steps_per_pixel, nsteps - 1);
+				std::size_t qb = std::clamp<std::size_t>((line*timing.x_total + x1) * steps_per_pixel, qa + 1, nsteps);
+
+				std::uint64_t s = 0, n = 0;
+				for (std::size_t q = qa; q < qb; q++) {
+					std::size_t slot = (q % nphases) * len + q / nphases;
+					s += acc[slot];
+					n += cnt[slot];
+				}
+
+				double v = n ? double(s) / n : fill;
+				out[r*cols + c] = v/127.5 - 1;
+			}
+		}
+	}
+
+private:
+	static constexpr std::uint64_t ONE = std::uint64_t(1) << 32;
+
+	void start_frame() {
+		// The frame's first sample sits `delta` (fraction of a sample)
+		// after the frame starts, and the next frame starts period - delta
+		// after it
+		std::uint64_t rest = period_fx - delta;
+		frame_len = (rest + ONE - 1) >> 32;
+		row = (delta * nphases) >> 32;
+		pos = 0;
+	}
+
+	std::size_t advance(const unsigned char* in, std::size_t n) {
+		std::size_t made = 0;
+		std::size_t i = 0;
+
+		while (i < n) {
+			std::size_t take = std::min(n - i, frame_len - pos);
+
+			if (in) {
+				add(in + i, take, acc.data() + row*len + pos, cnt.data() + row*len + pos);
+			}
+			i += take;
+			pos += take;
+
+			if (pos == frame_len) {
+				delta = (frame_len << 32) - (period_fx - delta);
+				start_frame();
+				nframes++;
+				made++;
+			}
+		}
+
+		return made;
+	}
+
+	static void add(const unsigned char* in, std::size_t n, std::uint32_t* a, std::uint32_t* c) {
+		std::size_t i = detail::raster_add_simd(in, n, a, c);
+		for (; i < n; i++) {
+			a[i] += in[i];
+			c[i]++;
+		}
+	}
+
+	DisplayTiming timing;
+	std::size_t nphases;
+
+	double period = 0;            // samples per frame
+	std::uint64_t period_fx = 0;  // the same, 32.32 fixed point
+	std::size_t len = 0;          // longest frame run, samples
+
+	aligned_vector<std::uint32_t> acc; // nphases rows of len sample sums
+	aligned_vector<std::uint32_t> cnt; // and how many samples each holds
+
+	std::uint64_t delta = 0;  // phase of the current frame's first sample, 0.32 fixed point
+	std::size_t frame_len = 0; // samples in the current frame
+	std::size_t row = 0;       // its phase row
+	std::size_t pos = 0;       // samples of it pushed so far
+	std::uint64_t nframes = 0;
+};
+
+} // namespace rtlsdr
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef RTLSDRPP_SOURCES_HPP
+#define RTLSDRPP_SOURCES_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+// Sample sources that need no dongle: replay of raw `rtl_sdr` captures and
+// a deterministic signal generator. Both implement SdrBackend, so anything
+// written against it runs unchanged in CI and benchmarks.
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <random>
+#include <complex>
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <numbers>
+
+#include "rtlsdrpp.hpp"
+#include "capture.hpp"
+
+namespace rtlsdr {
+
+class ReplaySdr: public SdrBackend {
+	// Plays back an `rtl_sdr`-format capture (interleaved u8 I/Q)
+	//
+	// The file is memory-mapped, so views are handed out straight from the
+	// page cache without copying. Tuning calls are accepted and remembered
+	// but don't change what comes out of the file. The sample rate is the
+	// one exception: the capture can't be resampled, so asking for any
+	// other rate throws.
+	//
+	// Arguments:
+	//	path (str): Capture file
+	//	loop (bool): Wrap around at end of file instead of throwing
+	//	sample_rate (int): Rate the capture was taken at, reported back
+	//		through `get_sample_rate()`
+	//
+public:
+	using SdrBackend::read_bytes;
+
+	ReplaySdr(const std::string& path, bool loop=true, std::uint32_t sample_rate=DEFAULT_RS):
+		file(path), data(file.data()), len(file.size()), looping(loop) {
+
+		note_sample_rate(sample_rate);
+		note_center_freq(DEFAULT_FC);
+	}
+
+	void set_center_freq(std::uint32_t freq) override { note_center_freq(freq); }
+	std::uint32_t get_center_freq() override { return tuner_state().center_freq; }
+	void set_sample_rate(std::uint32_t rate) override {
+		std::uint32_t captured = tuner_state().sample_rate;
+		if (rate != captured) {
+			throw std::invalid_argument("Capture was taken at " + std::to_string(captured) +
+				" S/s, can't replay it at " + std::to_string(rate));
+		}
+	}
+	std::uint32_t get_sample_rate() override { return tuner_state().sample_rate; }
+	void set_gain(int gain) override { note_gain(gain); }
+	void set_direct_sampling(int direct) override { note_direct_sampling(direct); }
+
+	std::size_t size() const { return len; }
+	std::size_t tell() const { return pos; }
+	void seek(std::size_t offset) { pos = offset % len; }
+
+	std::span<unsigned char> read_bytes(std::span<unsigned char> dest) override {
+		std::size_t copied = 0;
+		while (copied < dest.size()) {
+			std::size_t n = take(dest.size() - copied);
+			std::memcpy(dest.data() + copied, data + pos - n, n);
+			copied += n;
+		}
+
+		stamp(dest.size());
+		return dest;
+	}
+
+	std::span<const unsigned char> read_bytes_view(std::size_t num_bytes=DEFAULT_READ_SIZE) override {
+		// Zero-copy unless the read straddles the end of a looping file
+		if (pos + num_bytes <= len) {
+			std::size_t start = pos;
+			take(num_bytes);
+			stamp(num_bytes);
+			return std::span<const unsigned char>(data + start, num_bytes);
+		}
+
+		return SdrBackend::read_bytes_view(num_bytes);
+	}
+
+private:
+	std::size_t take(std::size_t want) {
+		// Advances the cursor by up to `want` bytes without crossing EOF,
+		// returning how many were taken
+		if (pos == len) {
+			if (!looping) {
+				throw std::out_of_range("End of capture reached");
+			}
+			pos = 0;
+		}
+
+		std::size_t n = std::min(want, len - pos);
+		pos += n;
+		return n;
+	}
+
+	MappedFile file;
+	const unsigned char* data;
+	std::size_t len;
+	std::size_t pos = 0;
+	bool looping;
+};
+
+struct Tone {
+	double freq;              // absolute, Hz
+	double amplitude = 0.25;  // full scale = 1
+	double mod_freq = 0;      // AM tone frequency, Hz (0 = unmodulated carrier)
+	double mod_index = 0;     // AM depth, 0..1
+};
+
+class SyntheticSdr: public SdrBackend {
+	// Deterministic signal generator with a dongle's output format
+	//
+	// Each Tone is placed at its absolute frequency relative to the current
+	// center frequency, optionally amplitude modulated as
+	// s(t) = A[1 + m cos(2 pi f_t t)] cos(2 pi f_c t), then Gaussian noise is
+	// added and the result quantized to u8 I/Q just like the RTL2832 does.
+	// The same seed always yields the same byte stream.
+	//
+	// With direct sampling on, the tuner is bypassed: every byte is one
+	// real ADC sample. As with librtlsdr, where set_center_freq() then
+	// programs the RTL2832's IF instead of the tuner, a tone shows up at its
+	// offset from the center frequency, s(t) = A cos(2 pi (f - f_c) t), and
+	// a negative offset folds onto the positive one.
+	//
+	// Notes:
+	//	Time is carried across reads, so back-to-back reads are one
+	//	continuous signal.
+	//
+public:
+	using SdrBackend::read_bytes;
+
+	SyntheticSdr(std::vector<Tone> tones_={}, double noise_rms_=0.01, std::uint32_t seed=1):
+		tones(std::move(tones_)), noise_rms(noise_rms_), rng(seed) {
+
+		note_sample_rate(DEFAULT_RS);
+		note_center_freq(DEFAULT_FC);
+		note_gain(DEFAULT_GAIN);
+	}
+
+	void add_tone(const Tone& t) { tones.push_back(t); }
+
+	void set_center_freq(std::uint32_t freq) override { note_center_freq(freq); }
+	std::uint32_t get_center_freq() override { return tuner_state().center_freq; }
+	void set_sample_rate(std::uint32_t rate) override { note_sample_rate(rate); }
+	std::uint32_t get_sample_rate() override { return tuner_state().sample_rate; }
+	void set_gain(int gain) override { note_gain(gain); }
+	void set_direct_sampling(int direct) override { note_direct_sampling(direct); }
+
+	std::vector<int> gain_steps() override {
+		// Every whole dB an R820T covers
+		std::vector<int> steps(49);
+		std::iota(std::begin(steps), std::end(steps), 1);
+		return steps;
+	}
+
+	std::span<unsigned char> read_bytes(std::span<unsigned char> dest) override {
+		constexpr double two_pi = 2*std::numbers::pi;
+
+		TunerState st = tuner_state();
+		bool real = st.direct_sampling != 0;
+		double fc = st.center_freq;
+		int gain = st.gain;
+
+		std::size_t num_samples = real ? dest.size() : dest.size()/2;
+		double dt = 1.0/st.sample_rate;
+		double t0 = n_generated * dt;
+
+		// Manual gain is in dB, referenced so 20 dB is unity; 0 means AGC
+		double g = (gain == 0) ? 1.0 : std::pow(10.0, (gain - 20)/20.0);
+
+		if (scratch.size() < num_samples) {
+			scratch.resize(num_samples);
+		}
+		std::fill_n(std::begin(scratch), num_samples, 0);
+
+		for (const auto& tone: tones) {
+			// Step a phasor instead of calling sin/cos per sample; it is
+			// re-seeded from absolute time on every read so it can't drift
+			double w = two_pi*(tone.freq - fc);
+			std::complex<double> ph = std::polar(g*tone.amplitude, w*t0);
+			std::complex<double> step = std::polar(1.0, w*dt);
+
+			if (tone.mod_freq > 0) {
+				std::complex<double> mph = std::polar(1.0, two_pi*tone.mod_freq*t0);
+				std::complex<double> mstep = std::polar(1.0, two_pi*tone.mod_freq*dt);
+
+				for (std::size_t i = 0; i < num_samples; i++) {
+					scratch[i] += ph * (1 + tone.mod_index*mph.real());
+					ph *= step;
+					mph *= mstep;
+				}
+			}
+			else {
+				for (std::size_t i = 0; i < num_samples; i++) {
+					scratch[i] += ph;
+					ph *= step;
+				}
+			}
+		}
+
+		std::normal_distribution<double> noise(0.0, noise_rms);
+
+		if (real) {
+			// The real part of each phasor is the A cos(2 pi f t) term
+			for (std::size_t i = 0; i < num_samples; i++) {
+				dest[i] = quantize(scratch[i].real() + noise(rng));
+			}
+		}
+		else {
+			for (std::size_t i = 0; i < num_samples; i++) {
+				dest[2*i]   = quantize(scratch[i].real() + noise(rng));
+				dest[2*i+1] = quantize(scratch[i].imag() + noise(rng));
+			}
+		}
+
+		if (!real && dest.size() % 2) {
+			dest[dest.size()-1] = quantize(noise(rng));
+		}
+
+		n_generated += num_samples;
+		stamp(dest.size());
+		return dest;
+	}
+
+private:
+	static unsigned char quantize(double v) {
+		return static_cast<unsigned char>(std::clamp(std::lround((v + 1) * 127.5), 0L, 255L));
+	}
+
+	std::vector<Tone> tones;
+	std::vector<std::complex<double>> scratch;
+	double noise_rms;
+	std::mt19937 rng;
+	std::uint64_t n_generated = 0;
+};
+
+inline std::unique_ptr<SdrBackend> open_backend(const std::string& spec, const TunerConfig& cfg={}) {
+	// Builds a backend from a short text spec and applies `cfg` to it
+	//
+	// Arguments:
+	//	spec (str): One of
+	//		""  or "rtlsdr"       first attached dongle
+	//		"rtlsdr:<serial>"     dongle with the given serial number
+	//		"file:<path>"         looped replay of an rtl_sdr capture,
+	//		                      taken at cfg's sample rate if it has one
+	//		"synth[:f1,f2,...]"   synthetic tones at the given frequencies (Hz)
+	//	cfg: Initial tuner settings. Dongles are opened with them directly
+	//		rather than having defaults written first.
+	//
+	auto colon = spec.find(':');
+	std::string kind = spec.substr(0, colon);
+	std::string arg = (colon == std::string::npos) ? "" : spec.substr(colon+1);
+
+	if (kind == "" || kind == "rtlsdr") {
+		return std::make_unique<RtlSdr>(0, false, arg, cfg);
+	}
+
+	if (kind == "file") {
+		// Raw captures carry no metadata, so the caller's rate is the
+		// capture's rate
+		auto replay = std::make_unique<ReplaySdr>(arg, true, cfg.sample_rate.value_or(DEFAULT_RS));
+		replay->configure(cfg);
+		return replay;
+	}
+
+	if (kind == "synth") {
+		auto synth = std::make_unique<SyntheticSdr>();
+
+		std::size_t start = 0;
+		while (start < arg.size()) {
+			std::size_t end = arg.find(',', start);
+			if (end == std::string::npos) {
+				end = arg.size();
+			}
+
+			synth->add_tone({std::stod(arg.substr(start, end - start))});
+			start = end + 1;
+		}
+
+		synth->configure(cfg);
+		return synth;
+	}
+
+	throw std::invalid_argument("Unknown SDR backend \"" + spec + "\"");
+}
+
+} // namespace rtlsdr
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef RTLSDRPP_SPECTROGRAM_HPP
+#define RTLSDRPP_SPECTROGRAM_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <span>
+#include <complex>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <cstdint>
+
+#include "fft.hpp"
+#include "window.hpp"
+#include "psd.hpp"
+
+namespace rtlsdr {
+
+template <typename T=float>
+class Spectrogram {
+	// Short-time power spectra of a continuous stream of real samples
+	//
+	// Samples are pushed in blocks of any size. Every `hop` samples, the
+	// last `nfft` are windowed and transformed, and the power spectrum
+	// goes into a ring of the `capacity` most recent frames. Each hop
+	// costs one FFT; the overlap between frames is never recomputed.
+	//
+	// Incoming samples are written twice into a ring of 2*nfft, at i and
+	// i + nfft, so the latest nfft samples are always contiguous and can
+	// be windowed in place of a copy. All buffers are sized here; pushing
+	// and reading frames never allocates.
+	//
+	// Frames are scaled like WelchPsd, so one frame reads the same as a
+	// single segment periodogram of the same window.
+	//
+	// Arguments:
+	//	nfft: Frame length, a power of two
+	//	hop: Samples between frame starts. Less than nfft overlaps frames,
+	//		more skips samples between them.
+	//	capacity: Frames kept
+	//	win: Window applied to every frame
+	//
+public:
+	using complex = std::complex<T>;
+
+	Spectrogram(std::size_t nfft_, std::size_t hop_, std::size_t capacity_, WindowSpec win={}):
+		nfft(nfft_), hop_len(hop_), cap(capacity_), fft(nfft_) {
+
+		if (hop_len == 0 || cap == 0) {
+			throw std::invalid_argument("Spectrogram needs a nonzero hop and capacity");
+		}
+
+		power = detail::select_kernel<detail::PowerAcc<T>::template K>(nfft);
+
+		ring.resize(2*nfft);
+		stage.resize(nfft);
+		spec.resize(fft.bins());
+		frame_buf.resize(cap * bins());
+
+		set_window(win);
+		reset();
+	}
+
+	void set_window(WindowSpec win) { window = &get_window<T>(win, nfft); }
+
+	const Window<T>& current_window() const { return *window; }
+
+	void reset() {
+		// Drops every sample and frame; the next frame needs nfft new samples
+		wpos = 0;
+		due = nfft;
+		head = 0;
+		count = 0;
+		produced = 0;
+	}
+
+	std::size_t size() const { return nfft; }
+	std::size_t hop() const { return hop_len; }
+	std::size_t capacity() const { return cap; }
+	std::size_t bins() const { return nfft/2; }
+
+	std::size_t frames() const { return count; } // frames held, up to capacity()
+	std::uint64_t total_frames() const { return produced; } // since reset()
+
+	std::size_t push(std::span<const T> x) {
+		// Streams samples in, producing any frames they complete
+		//
+		// Returns:
+		//	size_t: Frames produced by this call (the oldest drop out of the
+		//		ring once it's full)
+		//
+		std::size_t made = 0;
+		std::size_t i = 0;
+
+		while (i < x.size()) {
+			std::size_t take = std::min({x.size() - i, nfft - wpos, due});
+
+			std::copy_n(x.data() + i, take, ring.data() + wpos);
+			std::copy_n(x.data() + i, take, ring.data() + wpos + nfft);
+
+			i += take;
+			wpos = (wpos + take) % nfft;
+			due -= take;
+
+			if (due == 0) {
+				transform();
+				due = hop_len;
+				made++;
+			}
+		}
+
+		return made;
+	}
+
+	std::span<const T> frame(std::size_t i) const {
+		// Power spectrum of frame i, 0 being the oldest held, bins() bins
+		// from DC up to but not including Nyquist
+		if (i >= count) {
+			throw std::out_of_range("Spectrogram holds " + std::to_string(count) + " frames, asked for " + std::to_string(i));
+		}
+
+		std::size_t slot = (head + cap - count + i) % cap;
+		return std::span<const T>(frame_buf.data() + slot*bins(), bins());
+	}
+
+	std::span<const T> latest() const { return frame(count - 1); }
+
+	void matrix(std::span<T> out) const {
+		// Copies the held frames, oldest first, as a frames() x bins()
+		// row-major matrix
+		if (out.size() < count * bins()) {
+			throw std::length_error("Spectrogram matrix needs " + std::to_string(count * bins()) + " values");
+		}
+
+		for (std::size_t i = 0; i < count; i++) {
+			auto f = frame(i);
+			std::copy(std::begin(f), std::end(f), std::begin(out) + i*bins());
+		}
+	}
+
+	void features(std::span<T> out, std::size_t rows, std::size_t cols) const {
+		// Averages the held frames down to a rows x cols (time x frequency)
+		// row-major grid, oldest frames in row 0. Where the grid is finer
+		// than the frames, frames or bins repeat.
+		if (rows == 0 || cols == 0 || out.size() < rows*cols) {
+			throw std::length_error("Spectrogram features need a nonempty grid of at most " +
+				std::to_string(out.size()) + " values");
+		}
+
+		std::fill(std::begin(out), std::begin(out) + rows*cols, 0);
+		if (count == 0) {
+			return;
+		}
+
+		std::size_t nb = bins();
+		for (std::size_t r = 0; r < rows; r++) {
+			std::size_t fa = r*count / rows, fb = std::max((r+1)*count / rows, fa + 1);
+			T* row = out.data() + r*cols;
+
+			for (std::size_t f = fa; f < fb; f++) {
+				const T* p = frame(f).data();
+
+				for (std::size_t c = 0; c < cols; c++) {
+					std::size_t ba = c*nb / cols, bb = std::max((c+1)*nb / cols, ba + 1);
+
+					T acc = 0;
+					for (std::size_t k = ba; k < bb; k++) {
+						acc += p[k];
+					}
+					row[c] += acc / (bb - ba);
+				}
+			}
+
+			for (std::size_t c = 0; c < cols; c++) {
+				row[c] /= (fb - fa);
+			}
+		}
+	}
+
+private:
+	void transform() {
+		// The latest nfft samples start at wpos in the doubled ring
+		window->apply(std::span<const T>(ring.data() + wpos, nfft), stage);
+		fft.forward(stage, spec);
+
+		T* dst = frame_buf.data() + head*bins();
+		std::fill(dst, dst + bins(), 0);
+		power(reinterpret_cast<const T*>(spec.data()), dst, window->power_scale(), nfft);
+
+		head = (head + 1) % cap;
+		count = std::min(count + 1, cap);
+		produced++;
+	}
+
+	std::size_t nfft;
+	std::size_t hop_len;
+	std::size_t cap;
+
+	RealFft<T> fft;
+	const Window<T>* window;
+	void (*power)(const T*, T*, T, std::size_t);
+
+	aligned_vector<T> ring;       // input, written twice
+	aligned_vector<T> stage;      // windowed frame
+	aligned_vector<complex> spec; // its half spectrum
+	aligned_vector<T> frame_buf;  // cap frames of bins() each
+
+	std::size_t wpos; // next write position in the ring, < nfft
+	std::size_t due;  // samples until the next frame
+	std::size_t head; // slot the next frame goes into
+	std::size_t count;
+	std::uint64_t produced;
+};
+
+} // namespace rtlsdr
+
+#endif
@@ -5,9 +5,12 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <memory>
 #include <iterator>
 #include <algorithm>
 #include <numeric>
+#include <functional>
+#include <initializer_list>
 #include <stdexcept>
 #include <cmath>
 
@@ -15,7 +18,15 @@
 
 #include "constants.hpp"
 #include "simpletcp.hpp"
-#include "rtlsdrpp.hpp"
+#include "devicepool.hpp"
+#include "iqcorrect.hpp"
+#include "psd.hpp"
+#include "panorama.hpp"
+#include "spectrogram.hpp"
+#include "goertzel.hpp"
+#include "raster.hpp"
+#include "threadpool.hpp"
+#include "bufferpool.hpp"
 #include "csv.hpp"
 
 using cv::ml::TrainData;
@@ -39,7 +50,7 @@ enum RespCode {
 
 class TempespSrv {
 public:
-	TempespSrv(int port);
+	TempespSrv(int port, const std::string& sdr_spec="", const SrvConfig& cfg={});
 	
 	///////////////////////////////////////////////////////////
 	// TCP FUNCS
@@ -57,8 +68,17 @@ public:
 	///////////////////////////////////////////////////////////
 	
 	void conf_sdr();
+	void set_window(const std::string& name);
 	void collect_em_data(float flo, float fhi, std::size_t nsteps);
+	void collect_stft_data(float fc);
+	void collect_harmonic_data(float fc);
+	static std::vector<double> harmonics(float fc);
+	static std::vector<double> harmonics(float fc, double line_rate);
+	double measure_line_rate(float fc);
 	void write_to_tdfile(std::size_t img_n);
+	cv::Mat reconstruct_img(float fc, std::size_t nframes);
+	void set_raster_trim(double ppm) { raster_trim = ppm; }
+	double raster_frame_rate() const { return SAMPLE_RATE / raster.frame_period(); }
 	
 	///////////////////////////////////////////////////////////
 	// MLP FUNCS
@@ -76,8 +96,71 @@ private:
 	std::vector<unsigned char> tcpdata;
 	cv::Mat loaded_img;
 
-	rtlsdr::RtlSdr sdr;
-	std::vector<float> psd;
+	SrvConfig cfg;
+	std::string shape_suffix() const;
+	void require_mode(const char* what, std::initializer_list<FeatureMode> modes) const;
+	void normalize_psd();
+	void capture(float fc, const std::function<bool(std::span<const float>, std::size_t)>& on_block);
+	void capture_bytes(float fc, const std::function<bool(std::span<const unsigned char>, std::size_t)>& on_block);
+	rtlsdr::aligned_vector<unsigned char> stream_buf; // capture_bytes' reads from a streaming dongle
+
+	static rtlsdr::TunerConfig sdr_config();
+	static std::size_t stft_frames(std::size_t hop);
+
+	rtlsdr::DevicePool sdrs;
+	std::vector<float> psd; // MLP features, cfg.inputs() of them
+	rtlsdr::WindowSpec window = rtlsdr::parse_window("welch");
+
+	struct SdrScratch {
+		rtlsdr::IqCorrector<float> dc; // the dongle's ADC offset, tracked across sweeps
+	};
+	std::vector<SdrScratch> scratch; // one per device in `sdrs`
+
+	// Step transforms run on the pool; each worker has its own plan and
+	// buffers, and writes only row `step` of step_psd
+	struct DspScratch {
+		DspScratch(std::size_t nsamps): welch(nsamps, NSEGMENTS, SEG_OVERLAP) {}
+
+		rtlsdr::WelchPsd<float> welch;
+	};
+	rtlsdr::ThreadPool pool;
+	std::vector<DspScratch> dsp; // one per pool worker
+
+	// Converted sample blocks, recycled: a step's block goes back as soon
+	// as its transform is done, so only the blocks in flight take memory
+	rtlsdr::BufferPool<float> blocks;
+	std::vector<rtlsdr::BufferPool<float>::Buffer> step_blocks; // held by step until transformed
+
+	std::vector<std::uint32_t> sweep_freqs;
+	float plan_flo = 0, plan_fhi = 0;
+	std::size_t plan_nsteps = 0;
+
+	std::vector<float> step_psd;   // one PSD per step
+	std::vector<float> step_sum;   // their sum, when not stitched
+
+	// Panoramic mode: the step PSDs are stitched onto one absolute
+	// frequency axis instead of summed
+	rtlsdr::Panorama pano;
+
+	// Spectrogram mode: a continuous capture at one frequency, kept as
+	// time x frequency instead of averaged
+	rtlsdr::Spectrogram<float> stft;
+
+	// Harmonic mode: Goertzel filters on the display's line and frame
+	// rate harmonics only, placed at the line rate measured on a fine PSD
+	// (line_welch over line_block) before every capture
+	rtlsdr::GoertzelBank harm;
+	rtlsdr::WelchPsd<float> line_welch;
+	rtlsdr::aligned_vector<float> line_block;
+	std::vector<float> line_psd;
+
+	// Raster mode: the stream folded onto the display's frame, timed by
+	// the frame period measured on the first frames (held in raster_est),
+	// trimmed by raster_trim ppm
+	rtlsdr::RasterAverager raster;
+	std::vector<unsigned char> raster_est;
+	double raster_trim = 0;
+	std::vector<float> raster_img;
 
 	cv::Ptr<ANN_MLP> mlp;
 };
@@ -86,12 +169,23 @@ private:
 // Definitions
 //////////////////////////////////////////////////////////////////
 
-TempespSrv::TempespSrv(int port): tcpsrv(port) { 
+TempespSrv::TempespSrv(int port, const std::string& sdr_spec, const SrvConfig& cfg_):
+	tcpsrv(port), cfg(cfg_), sdrs(rtlsdr::DevicePool::from_spec(sdr_spec, sdr_config())),
+	pano(SAMPLE_RATE/cfg_.nsamps, cfg_.bins()),
+	stft(cfg_.nsamps, cfg_.nsamps/2, stft_frames(cfg_.nsamps/2)),
+	harm(std::vector<double>(), SAMPLE_RATE, HARM_WINDOW),
+	line_welch(HARM_EST_NFFT, HARM_EST_SEGMENTS),
+	raster(rtlsdr::DisplayTiming{PIXEL_CLOCK, X_TOTAL, Y_TOTAL}, SAMPLE_RATE),
+	raster_img(RASTER_COLS * Y_TOTAL) { 
+	stream_buf.resize(STREAM_READ);
 	conf_sdr();
-	load_MLP_model();
+	if (cfg.mode != FeatureMode::Raster) {
+		load_MLP_model(); // raster mode has no model
+	}
 	accept_cli(); 
 
-	psd.resize(NSAMPS/2);
+	psd.resize(cfg.inputs());
+	step_sum.resize(cfg.bins());
 }
 
 ///////////////////////////////////////////////////////////
@@ -133,41 +227,358 @@ void TempespSrv::send_img() {
 // SDR FUNCS
 ///////////////////////////////////////////////////////////
 
+rtlsdr::TunerConfig TempespSrv::sdr_config() {
+	rtlsdr::TunerConfig cfg;
+	cfg.sample_rate = SAMPLE_RATE;
+	cfg.direct_sampling = 2;
+	cfg.gain = 0;
+
+	return cfg;
+}
+
 void TempespSrv::conf_sdr() {
-	sdr.set_sample_rate(2.4e6);
-	sdr.set_direct_sampling(2);
-	sdr.set_gain(0);
+	// Devices are opened with this config, so on a fresh pool this
+	// doesn't touch the USB bus at all
+	sdrs.for_each([](rtlsdr::SdrBackend& sdr) {
+		sdr.configure(sdr_config());
+	});
+
+	scratch.resize(sdrs.size());
+
+	// Each plan picks its size-specific kernels once, here
+	dsp.assign(pool.num_slots(), DspScratch(cfg.nsamps));
+	for (auto& d: dsp) {
+		d.welch.set_window(window);
+	}
+	stft.set_window(window);
+
+	// Enough blocks for every device's step plus a couple queued per worker;
+	// a slower pool just grows it a little on the first sweep
+	blocks.reserve(sdrs.size() + 2*pool.num_slots(), std::max(dsp.front().welch.block_size(), STREAM_READ));
+
+	std::cout << cfg.nsamps << "-point PSD ("
+		<< (rtlsdr::has_fixed_kernels(cfg.nsamps) ? "fixed-size" : "generic") << " kernels), "
+		<< cfg.inputs() << " MLP inputs\n";
+}
+
+void TempespSrv::set_window(const std::string& name) {
+	// See rtlsdr::parse_window for names, e.g. "hann" or "kaiser:8.6"
+	window = rtlsdr::parse_window(name);
+	for (auto& d: dsp) {
+		d.welch.set_window(window);
+	}
+	stft.set_window(window);
 }
 
 void TempespSrv::collect_em_data(float flo, float fhi, std::size_t nsteps) {
-	float fcent = flo;
-	float logstep = std::pow(fhi/flo,  1.0/nsteps);
+	require_mode("A sweep", {FeatureMode::Sweep, FeatureMode::Panorama});
+
+	// One longer read per step feeds NSEGMENTS overlapped periodograms
+	std::size_t block = dsp.front().welch.block_size();
+
+	// Only rebuild the frequency plan when the sweep changes
+	if (flo != plan_flo || fhi != plan_fhi || nsteps != plan_nsteps) {
+		sweep_freqs = rtlsdr::log_sweep(flo, fhi, nsteps);
+		plan_flo = flo;
+		plan_fhi = fhi;
+		plan_nsteps = nsteps;
+
+		// Direct sampling: bin k of a step is k*fs/nsamps above its tune
+		pano.set_plan(sweep_freqs);
+		step_blocks.resize(sweep_freqs.size());
+		step_psd.resize(sweep_freqs.size() * cfg.bins());
+	}
 
-	std::vector<std::complex<double>> fft_n(NSAMPS);
+	// Each device reads step k+1 while its callback converts step k
+	// (sdrs.timing(dev) shows the overlap). The callback only does the
+	// order-dependent part, the running DC estimate, and hands the
+	// transform to the pool.
+	std::size_t bins = cfg.bins();
+	auto on_step = [this, block, bins](std::size_t dev, const rtlsdr::SweepBlock& blk) {
+		auto buf = blocks.acquire(block);
+		rtlsdr::convert_samples<float>(blk.bytes, buf.span());
+		scratch[dev].dc.process(buf.span());
+		step_blocks[blk.step] = std::move(buf);
+
+		pool.submit([this, bins, step = blk.step](std::size_t w) {
+			// ADC offset is already gone, so bin 0 holds real signal
+			std::span<float> row(step_psd.data() + step*bins, bins);
+			std::fill(std::begin(row), std::end(row), 0);
+			dsp[w].welch.accumulate(step_blocks[step].span(), row);
+			step_blocks[step].release();
+		});
+	};
 
-	// Resize (if needed) and zero values to prepare for sum
-	std::for_each(std::begin(psd), std::end(psd), [](auto& f) { f = 0; });
-	
-	while (fcent <= fhi) {
-		sdr.set_center_freq(fcent);
-		auto samples = sdr.read_samples_direct(NSAMPS);
-		
-		// Welch windowing function
-		double N;
-		for (std::size_t n = 0; n < NSAMPS; n++) {
-			N = (n - NSAMPS/2.0) / (NSAMPS/2.0);
-			samples[n] *= 1.0 - N*N;
+	try {
+		sdrs.sweep(sweep_freqs, block, on_step);
+	}
+	catch (...) {
+		// Transforms already queued still use their step_blocks
+		try { pool.wait(); } catch (...) {}
+		throw;
+	}
+	pool.wait();
+
+	if (cfg.mode == FeatureMode::Panorama) {
+		// The MLP sees the stitched spectrum averaged down to its inputs
+		pano.stitch(step_psd);
+		pano.features(psd);
+	}
+	else {
+		// Sum in step order so the result doesn't depend on which worker
+		// finished first
+		std::fill(std::begin(step_sum), std::end(step_sum), 0);
+		for (std::size_t s = 0; s < sweep_freqs.size(); s++) {
+			const float* row = step_psd.data() + s*bins;
+			for (std::size_t i = 0; i < bins; i++) {
+				step_sum[i] += row[i];
+			}
+		}
+
+		// A plain copy unless the MLP is narrower than the PSD
+		rtlsdr::Panorama::downsample(step_sum, psd);
+	}
+
+	normalize_psd();
+}
+
+std::size_t TempespSrv::stft_frames(std::size_t hop) {
+	// STFT frames `hop` apart that span STFT_DISPLAY_FRAMES of the
+	// display's frames (about 40000 samples each), so the spectrogram's
+	// time axis sees the frame rate structure and not a sliver of one
+	// frame
+	double frame_samples = SAMPLE_RATE * X_TOTAL * Y_TOTAL / PIXEL_CLOCK;
+	return std::ceil(STFT_DISPLAY_FRAMES * frame_samples / hop);
+}
+
+void TempespSrv::collect_stft_data(float fc) {
+	// Captures continuously at `fc` on the first device until the frame
+	// ring is full, then hands the MLP the spectrogram averaged down to
+	// cfg.stft_rows time slices of the spectrum, oldest first
+	require_mode("A spectrogram", {FeatureMode::Spectrogram});
+
+	std::size_t rows = cfg.stft_rows;
+	if (rows == 0 || psd.size() % rows) {
+		throw std::logic_error(std::to_string(psd.size()) + " MLP inputs don't split into " +
+			std::to_string(rows) + " spectrogram rows");
+	}
+
+	stft.reset();
+	capture(fc, [this](std::span<const float> x, std::size_t lost) {
+		if (lost) {
+			stft.reset(); // frames across the hole would mix two times
 		}
+		stft.push(x);
+		return stft.total_frames() < stft.capacity();
+	});
 
-		cv::dft(samples, fft_n, cv::DFT_COMPLEX_OUTPUT);
+	stft.features(psd, rows, psd.size() / rows);
+	normalize_psd();
+}
 
-		// don't care about 0 Hz component
-		for (std::size_t i = 0; i < NSAMPS/2; i++)
-			psd[i] += std::norm(fft_n[i]);
-		
-		fcent *= logstep;
+std::vector<double> TempespSrv::harmonics(float fc) {
+	// harmonics() at the nominal line rate; as many as the MLP gets
+	return harmonics(fc, PIXEL_CLOCK / X_TOTAL);
+}
+
+std::vector<double> TempespSrv::harmonics(float fc, double line_rate) {
+	// Line harmonics of the target display, with their frame rate
+	// sidebands, that a capture tuned to `fc` sees; as offsets from `fc`
+	//
+	// Which harmonics are tracked comes from the nominal timing, keeping
+	// clear of the band edges by the clock tolerance, so the count doesn't
+	// depend on `line_rate`. They're placed at `line_rate`: the whole
+	// raster runs off the pixel clock, so every harmonic and sideband
+	// scales with it.
+	rtlsdr::DisplayTiming timing{PIXEL_CLOCK, X_TOTAL, Y_TOTAL};
+	double margin = rtlsdr::DEFAULT_PERIOD_TOLERANCE * (fc + SAMPLE_RATE/2);
+
+	auto freqs = rtlsdr::display_harmonics(timing, fc + margin, fc + SAMPLE_RATE/2 - margin, HARM_SIDEBANDS);
+	double scale = line_rate / timing.h_freq();
+	for (auto& f: freqs) {
+		f = f*scale - fc;
+	}
+
+	return freqs;
+}
+
+double TempespSrv::measure_line_rate(float fc) {
+	// The display's actual line rate, from the spacing of its harmonics in
+	// a fine PSD of a gapless stretch of capture at `fc`. It's off the
+	// nominal one by up to the clock tolerance, hundreds of Hz at the
+	// upper harmonics, many times the Goertzel resolution.
+	std::size_t filled = 0;
+	line_block.resize(line_welch.block_size());
+	capture(fc, [this, &filled](std::span<const float> x, std::size_t lost) {
+		if (lost) {
+			filled = 0;
+		}
+		std::size_t take = std::min(x.size(), line_block.size() - filled);
+		std::copy_n(x.data(), take, line_block.data() + filled);
+		filled += take;
+		return filled < line_block.size();
+	});
+
+	line_psd.assign(line_welch.bins(), 0);
+	line_welch.accumulate(line_block, line_psd);
+
+	return rtlsdr::estimate_line_rate(line_psd, SAMPLE_RATE/HARM_EST_NFFT, PIXEL_CLOCK / X_TOTAL, fc);
+}
+
+void TempespSrv::collect_harmonic_data(float fc) {
+	// Captures continuously at `fc` on the first device and measures
+	// only the display's harmonics (see notes.md), at much finer
+	// resolution than the PSD. The MLP gets one input per harmonic, so
+	// it has to be configured with harmonics(fc).size() inputs.
+	require_mode("Harmonic data", {FeatureMode::Harmonic});
+
+	harm.set_freqs(harmonics(fc, measure_line_rate(fc)));
+	if (harm.size() != psd.size()) {
+		throw std::logic_error(std::to_string(psd.size()) + " MLP inputs, but " +
+			std::to_string(harm.size()) + " harmonics at " + std::to_string(fc) + " Hz");
+	}
+
+	// A coherent window can't span a hole in the stream; the one in
+	// progress is dropped and started again after it
+	harm.clear();
+	capture(fc, [this](std::span<const float> x, std::size_t lost) {
+		if (lost) {
+			harm.drop_window();
+		}
+		harm.push(x);
+		return harm.windows() < HARM_WINDOWS;
+	});
+
+	harm.powers(psd);
+	normalize_psd();
+}
+
+cv::Mat TempespSrv::reconstruct_img(float fc, std::size_t nframes) {
+	// Folds a continuous capture at `fc` onto the display's frame period
+	// for `nframes` frames and returns the averaged raster as an 8 bit
+	// image, one row per line, blanking included. The picture comes out
+	// rolled by wherever the capture started in the display's frame.
+	//
+	// The nominal period is only good to the display's clock tolerance,
+	// hundreds of samples, so the first RASTER_EST_FRAMES frames are held
+	// back to measure the real one. The raster is retimed to it (plus
+	// raster_trim, for a picture that still drifts) and they're folded in
+	// first. A hole in the stream before then restarts the measurement;
+	// after it, the raster skips the lost samples to stay in phase.
+	require_mode("Raster reconstruction", {FeatureMode::Raster});
+
+	rtlsdr::DisplayTiming nominal{PIXEL_CLOCK, X_TOTAL, Y_TOTAL};
+	double nominal_period = SAMPLE_RATE * X_TOTAL * Y_TOTAL / PIXEL_CLOCK;
+	std::size_t est_len = RASTER_EST_FRAMES * nominal_period * (1 + rtlsdr::DEFAULT_PERIOD_TOLERANCE) + 1;
+
+	raster_est.clear();
+	raster_est.reserve(est_len);
+	bool timed = false;
+
+	capture_bytes(fc, [&](std::span<const unsigned char> bytes, std::size_t lost) {
+		if (timed) {
+			raster.skip(lost);
+			raster.push(bytes);
+			return raster.frames() < nframes;
+		}
+
+		if (lost) {
+			raster_est.clear();
+		}
+		std::size_t take = std::min(bytes.size(), est_len - raster_est.size());
+		raster_est.insert(std::end(raster_est), std::begin(bytes), std::begin(bytes) + take);
+		if (raster_est.size() < est_len) {
+			return true;
+		}
+
+		double period = rtlsdr::estimate_frame_period(raster_est, nominal_period) * (1 + raster_trim*1e-6);
+		rtlsdr::DisplayTiming timing = nominal;
+		timing.pixel_clock = SAMPLE_RATE * X_TOTAL * Y_TOTAL / period;
+		raster.set_timing(timing, SAMPLE_RATE);
+
+		raster.push(raster_est);
+		raster.push(bytes.subspan(take));
+		timed = true;
+		return raster.frames() < nframes;
+	});
+
+	raster.image(raster_img, RASTER_COLS, Y_TOTAL);
+
+	cv::Mat img;
+	cv::normalize(cv::Mat(Y_TOTAL, RASTER_COLS, CV_32F, raster_img.data()), img, 0, 255, cv::NORM_MINMAX, CV_8U);
+	return img;
+}
+
+void TempespSrv::capture(float fc, const std::function<bool(std::span<const float>, std::size_t)>& on_block) {
+	// Same as capture_bytes, with the blocks converted and DC-free
+	auto buf = blocks.acquire(STREAM_READ);
+	capture_bytes(fc, [this, &buf, &on_block](std::span<const unsigned char> bytes, std::size_t lost) {
+		std::span<float> x = buf.span().first(bytes.size());
+		rtlsdr::convert_samples<float>(bytes, x);
+		scratch[0].dc.process(x);
+		return on_block(x, lost);
+	});
+}
+
+void TempespSrv::capture_bytes(float fc, const std::function<bool(std::span<const unsigned char>, std::size_t)>& on_block) {
+	// Tunes the first device to `fc` and hands it raw blocks in stream
+	// order until `on_block` returns false. With each block comes the
+	// number of bytes lost just before it, from the jump in the blocks'
+	// sample_index, so consumers that fold samples by their time can
+	// account for them.
+	//
+	// A dongle is streamed (RtlSdr::start_stream) for the capture, so it
+	// keeps sampling while `on_block` works, and blocks the host was too
+	// slow for show up as lost. Other backends never drop anything and
+	// are read synchronously.
+	auto& sdr = sdrs[0];
+	sdr.set_center_freq(fc);
+
+	auto* dongle = dynamic_cast<rtlsdr::RtlSdr*>(&sdr);
+	if (dongle == nullptr) {
+		sdr.read_bytes_view(rtlsdr::DEFAULT_SETTLE_BYTES); // still settling from the retune
+
+		std::uint64_t next = sdr.last_block().sample_index + rtlsdr::DEFAULT_SETTLE_BYTES/2;
+		for (;;) {
+			auto bytes = sdr.read_bytes_view(STREAM_READ);
+			std::uint64_t at = sdr.last_block().sample_index;
+			std::size_t lost = at > next ? 2*(at - next) : 0;
+			next = at + bytes.size()/2;
+
+			if (!on_block(bytes, lost)) {
+				return;
+			}
+		}
+	}
+
+	dongle->start_stream();
+	try {
+		std::size_t settled = dongle->read_stream(stream_buf.data(), rtlsdr::DEFAULT_SETTLE_BYTES);
+
+		rtlsdr::BlockInfo info;
+		std::uint64_t next = settled/2;
+		for (;;) {
+			std::size_t n = dongle->read_stream_block(stream_buf.data(), stream_buf.size(), &info);
+			if (n == 0) {
+				throw std::runtime_error("Stream stopped during a capture");
+			}
+
+			std::size_t lost = info.sample_index > next ? 2*(info.sample_index - next) : 0;
+			next = info.sample_index + n/2;
+
+			if (!on_block(std::span<const unsigned char>(stream_buf.data(), n), lost)) {
+				break;
+			}
+		}
+	}
+	catch (...) {
+		dongle->stop_stream();
+		throw;
 	}
+	dongle->stop_stream();
+}
 
+void TempespSrv::normalize_psd() {
 	// Normalize power spectrum, shift and scale so that 
 	// the mean is 0 and stddev is 1
 	
@@ -176,7 +587,7 @@ void TempespSrv::collect_em_data(float flo, float fhi, std::size_t nsteps) {
 		[maxp](float& d) {  d = (2 * d / maxp) - 1; }
 	);
 	/*
-	float mean = std::accumulate(std::cbegin(psd)+1, std::cend(psd), 0.0) / (NSAMPS/2.0);
+	float mean = std::accumulate(std::cbegin(psd)+1, std::cend(psd), 0.0) / (psd.size());
 	std::for_each(std::begin(psd)+1, std::end(psd),
 		[mean](float& d) {  d -= mean; }
 	);
@@ -188,11 +599,11 @@ void TempespSrv::write_to_tdfile(std::size_t img_n) {
 	// traindata is always appended to
 	// Nothing is done to control the size of the file
 	// Just uhhh, be reasonable about it
-	std::ofstream fout("../traindata.csv", std::ios::app);
+	std::ofstream fout("../traindata" + shape_suffix() + ".csv", std::ios::app);
 	csv::Writer td_csv(fout);
 	
-	std::vector<float> outp(NOUTPUTS, -0.999999);
-	outp[img_n] = 0.999999;
+	std::vector<float> outp(cfg.noutputs, -0.999999);
+	outp.at(img_n) = 0.999999;
 	
 	td_csv.write_fields(psd);
 	td_csv.write_row(outp);
@@ -202,10 +613,40 @@ void TempespSrv::write_to_tdfile(std::size_t img_n) {
 // MLP FUNCS
 ///////////////////////////////////////////////////////////
 
+std::string TempespSrv::shape_suffix() const {
+	// A model (and its training data) only fits the features and layer
+	// sizes it was made with, so other modes and shapes get files of their
+	// own. The default sweep keeps the original names.
+	std::string suffix;
+	if (cfg.mode != FeatureMode::Sweep) {
+		suffix = std::string("_") + mode_name(cfg.mode);
+	}
+	if (cfg.mode == FeatureMode::Spectrogram) {
+		suffix += std::to_string(cfg.stft_rows);
+	}
+
+	SrvConfig dflt;
+	if (cfg.nsamps != dflt.nsamps || cfg.inputs() != dflt.inputs() || cfg.noutputs != dflt.noutputs) {
+		suffix += "_" + std::to_string(cfg.nsamps) + "_" + std::to_string(cfg.inputs()) + "x" + std::to_string(cfg.noutputs);
+	}
+
+	return suffix;
+}
+
+void TempespSrv::require_mode(const char* what, std::initializer_list<FeatureMode> modes) const {
+	// Features of one mode mustn't end up in another mode's training
+	// data or model
+	if (std::find(std::begin(modes), std::end(modes), cfg.mode) == std::end(modes)) {
+		throw std::logic_error(std::string(what) + " can't be taken in " + mode_name(cfg.mode) + " mode");
+	}
+}
+
 void TempespSrv::load_MLP_model() {
-	std::cout << "Loading MLP model \"../MLP_model.yml\"..." << std::flush;
+	std::string path = "../MLP_model" + shape_suffix() + ".yml";
+
+	std::cout << "Loading MLP model \"" << path << "\"..." << std::flush;
 	try {
-		mlp = ANN_MLP::load("../MLP_model.yml");
+		mlp = ANN_MLP::load(path);
 		std::cout << " done!" << std::endl;
 	}
 	catch (cv::Exception& err) {
@@ -215,11 +656,12 @@ void TempespSrv::load_MLP_model() {
 		
 		cv::Mat_<int> layer_s(NLAYERS, 1);
 		
-		layer_s(0) = NINPUTS;
-		layer_s(NLAYERS-1) = NOUTPUTS;
+		std::size_t nin = cfg.inputs(), nout = cfg.noutputs;
+		layer_s(0) = nin;
+		layer_s(NLAYERS-1) = nout;
 		
 		for (std::size_t i = 1; i < NLAYERS-1; i++) {
-			layer_s(i) = (1.0*NOUTPUTS-NINPUTS)/(NLAYERS-1)*i + NINPUTS;
+			layer_s(i) = (1.0*nout-nin)/(NLAYERS-1)*i + nin;
 		}
 	
 		mlp->setLayerSizes(layer_s);
@@ -230,19 +672,27 @@ void TempespSrv::load_MLP_model() {
 		mlp->setActivationFunction(ANN_MLP::SIGMOID_SYM, 1, 1);
 		mlp->setTrainMethod(ANN_MLP::RPROP);
 	
-		mlp->save("../MLP_model.yml");
-		std::cout << "Reinitialized model at \"../MLP_model.yml\"\n";
+		mlp->save(path);
+		std::cout << "Reinitialized model at \"" << path << "\"\n";
 	}
 
+	cv::Mat layers = mlp->getLayerSizes();
+	std::size_t nin = layers.at<int>(0), nout = layers.at<int>(layers.total()-1);
+	if (nin != cfg.inputs() || nout != cfg.noutputs) {
+		throw std::runtime_error("Model \"" + path + "\" is " + std::to_string(nin) + " inputs x " +
+			std::to_string(nout) + " outputs, server is configured for " +
+			std::to_string(cfg.inputs()) + " x " + std::to_string(cfg.noutputs));
+	}
 }
 
 void TempespSrv::save_MLP_model() {
-	mlp->save("../MLP_model.yml");
+	mlp->save("../MLP_model" + shape_suffix() + ".yml");
 }
 
 void TempespSrv::train_MLP_model() {
 	// (filename, n_header_lines, response_start_ind, response_end_ind)
-	auto tdata = TrainData::loadFromCSV("../traindata.csv", 0, NINPUTS, NINPUTS+NOUTPUTS);
+	std::size_t nin = cfg.inputs();
+	auto tdata = TrainData::loadFromCSV("../traindata" + shape_suffix() + ".csv", 0, nin, nin + cfg.noutputs);
 	tdata->setTrainTestSplitRatio(0.8);
 	
 	if (mlp->isTrained()) {
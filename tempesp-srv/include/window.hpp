@@ -0,0 +1,250 @@
+#ifndef RTLSDRPP_WINDOW_HPP
+#define RTLSDRPP_WINDOW_HPP
+
+// This file is part of rtlsdrpp.
+// Copyright (C) 2020 by Nolan Chandler <https://github.com/ncchandler42>
+//
+// rtlsdrpp is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// rtlsdrpp is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with rtlsdrpp.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <string>
+#include <span>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include "fft.hpp"
+
+namespace rtlsdr {
+
+enum class WindowType {
+	Rectangular,
+	Welch,          // 1 - x^2, what the server has always used
+	Hann,
+	BlackmanHarris, // 4 term, -92 dB sidelobes
+	Kaiser,         // sidelobes set by beta
+	FlatTop         // amplitude accurate to ~0.01 dB anywhere in a bin
+};
+
+struct WindowSpec {
+	WindowType type = WindowType::Hann;
+	double beta = 8.6; // Kaiser only
+
+	bool operator<(const WindowSpec& o) const {
+		return std::tie(type, beta) < std::tie(o.type, o.beta);
+	}
+};
+
+inline WindowSpec parse_window(const std::string& name) {
+	// "rect", "welch", "hann", "blackman-harris", "flattop", or
+	// "kaiser[:beta]"
+	auto colon = name.find(':');
+	std::string kind = name.substr(0, colon);
+
+	if (kind == "kaiser") {
+		WindowSpec spec{WindowType::Kaiser};
+		if (colon != std::string::npos) {
+			spec.beta = std::stod(name.substr(colon + 1));
+		}
+		return spec;
+	}
+
+	if (colon != std::string::npos) {
+		throw std::invalid_argument("Window \"" + kind + "\" takes no parameter");
+	}
+
+	if (kind == "rect") return {WindowType::Rectangular};
+	if (kind == "welch") return {WindowType::Welch};
+	if (kind == "hann") return {WindowType::Hann};
+	if (kind == "blackman-harris") return {WindowType::BlackmanHarris};
+	if (kind == "flattop") return {WindowType::FlatTop};
+
+	throw std::invalid_argument("Unknown window \"" + name + "\"");
+}
+
+namespace detail {
+
+template <typename T>
+struct WindowMul {
+	// dst = src * w, over n samples (src may be dst)
+	template <std::size_t N>
+	struct K {
+		static void run(const T* src, const T* __restrict w, T* dst, std::size_t n_) {
+			const std::size_t n = N ? N : n_;
+			for (std::size_t i = 0; i < n; i++) {
+				dst[i] = src[i] * w[i];
+			}
+		}
+	};
+};
+
+} // namespace detail
+
+template <typename T=float>
+class Window {
+	// One window's taps plus the constants needed to normalize spectra
+	// taken through it
+	//
+	// Windows are periodic (DFT-even), the form meant for spectral
+	// analysis: w[n] for n = 0..N-1 samples one period of length N.
+	//
+	// Arguments:
+	//	spec: Window type and parameter
+	//	n: Length
+	//
+public:
+	Window(WindowSpec spec_, std::size_t n): spec(spec_), w(n) {
+		if (n == 0) {
+			throw std::invalid_argument("Window length must be nonzero");
+		}
+
+		mul = detail::select_kernel<detail::WindowMul<T>::template K>(n);
+
+		constexpr double pi = std::numbers::pi;
+		double s1 = 0, s2 = 0;
+
+		for (std::size_t i = 0; i < n; i++) {
+			double x = static_cast<double>(i) / n; // 0..1
+			double v = 1;
+
+			switch (spec.type) {
+			case WindowType::Rectangular:
+				break;
+
+			case WindowType::Welch: {
+				double u = 2*x - 1;
+				v = 1 - u*u;
+				break;
+			}
+
+			case WindowType::Hann:
+				v = 0.5 - 0.5*std::cos(2*pi*x);
+				break;
+
+			case WindowType::BlackmanHarris:
+				v = 0.35875 - 0.48829*std::cos(2*pi*x) + 0.14128*std::cos(4*pi*x) - 0.01168*std::cos(6*pi*x);
+				break;
+
+			case WindowType::Kaiser: {
+				double u = 2*x - 1;
+				v = bessel_i0(spec.beta * std::sqrt(1 - u*u)) / bessel_i0(spec.beta);
+				break;
+			}
+
+			case WindowType::FlatTop:
+				v = 0.21557895 - 0.41663158*std::cos(2*pi*x) + 0.277263158*std::cos(4*pi*x)
+					- 0.083578947*std::cos(6*pi*x) + 0.006947368*std::cos(8*pi*x);
+				break;
+			}
+
+			w[i] = v;
+			s1 += v;
+			s2 += v*v;
+		}
+
+		sum = s1;
+		sum_sq = s2;
+	}
+
+	WindowSpec type() const { return spec; }
+	std::size_t size() const { return w.size(); }
+	std::span<const T> taps() const { return w; }
+
+	double coherent_gain() const {
+		// Mean tap; a tone's FFT amplitude is scaled by N times this
+		return sum / w.size();
+	}
+
+	double enbw() const {
+		// Equivalent noise bandwidth, in bins
+		return w.size() * sum_sq / (sum * sum);
+	}
+
+	double power_scale() const {
+		// Multiplies |X[k]|^2 into power per bin with white noise read
+		// correctly (divide by the bin width in Hz too for a density)
+		return 1.0 / sum_sq;
+	}
+
+	double amplitude_scale() const {
+		// Multiplies |X[k]|^2 into a tone's power, for tones on a bin
+		return 1.0 / (sum * sum);
+	}
+
+	void apply(std::span<T> x) const {
+		// x *= w, in place
+		if (x.size() != w.size()) {
+			throw std::length_error("Window is " + std::to_string(w.size()) +
+				" samples, block is " + std::to_string(x.size()));
+		}
+
+		mul(x.data(), w.data(), x.data(), w.size());
+	}
+
+	void apply(std::span<const T> in, std::span<T> out) const {
+		// out = in * w; reads the first `size()` samples of `in`
+		if (in.size() < w.size() || out.size() < w.size()) {
+			throw std::length_error("Window is " + std::to_string(w.size()) +
+				" samples, block is " + std::to_string(std::min(in.size(), out.size())));
+		}
+
+		mul(in.data(), w.data(), out.data(), w.size());
+	}
+
+private:
+	static double bessel_i0(double x) {
+		// Power series; converges quickly for any beta used in practice
+		double sum = 1, term = 1, q = x*x/4;
+		for (int k = 1; k < 64 && term > 1e-17*sum; k++) {
+			term *= q / (k*k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	WindowSpec spec;
+	aligned_vector<T> w;
+	double sum = 0, sum_sq = 0;
+	void (*mul)(const T*, const T*, T*, std::size_t);
+};
+
+template <typename T=float>
+const Window<T>& get_window(WindowSpec spec, std::size_t n) {
+	// Shared, lazily built window of the given type and length. The
+	// reference stays valid for the life of the program.
+	static std::mutex mtx;
+	static std::map<std::pair<WindowSpec, std::size_t>, std::unique_ptr<Window<T>>> cache;
+
+	if (spec.type != WindowType::Kaiser) {
+		spec.beta = 0;
+	}
+
+	std::lock_guard<std::mutex> lock(mtx);
+
+	auto& slot = cache[{spec, n}];
+	if (!slot) {
+		slot = std::make_unique<Window<T>>(spec, n);
+	}
+
+	return *slot;
+}
+
+} // namespace rtlsdr
+
+#endif
@@ -1,18 +1,62 @@
 #include <iostream>
+#include <string>
 
 #include "tempesp_srv.hpp"
 
 const std::size_t NIMGS = 5;
 const std::size_t NSETS_PER_IMG = 1;
 const std::size_t NITERATIONS = 1;
+const std::size_t NRASTER_FRAMES = 300; // 5 s of frames at 60 Hz
 
-int main() {
+int main(int argc, char* argv[]) {
 	int port = 50001;
 
+	// SDR backend specs, see rtlsdr::DevicePool::from_spec
+	// (e.g. "synth:1e6", "file:cap.bin" or "rtlsdr:00000001;rtlsdr:00000002")
+	std::string sdr_spec = (argc > 1) ? argv[1] : "";
+
+	// PSD window, see rtlsdr::parse_window (e.g. "hann", "kaiser:8.6")
+	std::string window = (argc > 2) ? argv[2] : "welch";
+
+	// Features, see FeatureMode (e.g. "pano", "stft", "harm" or
+	// "raster"; default "sweep"). The captures are taken at flo.
+	SrvConfig cfg;
+	cfg.mode = parse_mode((argc > 3) ? argv[3] : "");
+
+	// PSD size and MLP input width (default one input per bin)
+	cfg.nsamps = (argc > 4) ? std::stoul(argv[4]) : cfg.nsamps;
+	cfg.ninputs = (argc > 5) ? std::stoul(argv[5]) : cfg.ninputs;
+	cfg.noutputs = NIMGS;
+
+	// Raster mode: trim on the measured frame period, ppm, for a picture
+	// that still drifts
+	double raster_trim = (argc > 6) ? std::stod(argv[6]) : 0;
+
 	double flo = 500e3, fhi = 1.75e6;
 	std::size_t nsteps_fsweep = 128;
+
+	if (cfg.mode == FeatureMode::Harmonic) {
+		cfg.ninputs = TempespSrv::harmonics(flo).size();
+	}
 	
-	TempespSrv tsrv(port);
+	TempespSrv tsrv(port, sdr_spec, cfg);
+	tsrv.set_window(window);
+	tsrv.set_raster_trim(raster_trim);
+
+	if (cfg.mode == FeatureMode::Raster) {
+		for (std::size_t img_n = 0; img_n < NIMGS; img_n++) {
+			tsrv.load_img(img_n);
+			tsrv.send_img();
+
+			std::string path = "../raster_" + std::to_string(img_n) + ".png";
+			cv::imwrite(path, tsrv.reconstruct_img(flo, NRASTER_FRAMES));
+			std::cout << "img=" << img_n << ",\treconstructed to \"" << path << "\" at " <<
+				tsrv.raster_frame_rate() << " Hz" << std::endl;
+		}
+
+		tsrv.send_cmd(CMD_STOP);
+		return 0;
+	}
 
 	for (std::size_t i = 0; i < NITERATIONS; i++) {
 		for (std::size_t img_n = 0; img_n < NIMGS; img_n++) {
@@ -20,7 +64,15 @@ int main() {
 			tsrv.send_img();
 			
 			for (std::size_t j = 0; j < NSETS_PER_IMG; j++) {
-				tsrv.collect_em_data(flo, fhi, nsteps_fsweep);
+				if (cfg.mode == FeatureMode::Spectrogram) {
+					tsrv.collect_stft_data(flo);
+				}
+				else if (cfg.mode == FeatureMode::Harmonic) {
+					tsrv.collect_harmonic_data(flo);
+				}
+				else {
+					tsrv.collect_em_data(flo, fhi, nsteps_fsweep);
+				}
 				tsrv.write_to_tdfile(img_n);
 				
 				std::cout << "img=" << img_n << ",\tpredict=" << tsrv.predict_img() << std::endl;